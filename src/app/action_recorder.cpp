@@ -0,0 +1,250 @@
+#include "action_recorder.h"
+
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace app {
+
+    namespace {
+        constexpr size_t FLUSH_THRESHOLD = 64 * 1024;
+
+        class Fnv1a {
+        public:
+            template <typename T>
+            void Add(const T& value) {
+                unsigned char bytes[sizeof(T)];
+                std::memcpy(bytes, &value, sizeof(T));
+                for (auto b : bytes) {
+                    hash_ ^= b;
+                    hash_ *= 1099511628211ull;
+                }
+            }
+            void Add(const std::string& str) {
+                for (unsigned char c : str) {
+                    hash_ ^= c;
+                    hash_ *= 1099511628211ull;
+                }
+            }
+            uint64_t Get() const {
+                return hash_;
+            }
+        private:
+            uint64_t hash_ = 14695981039346656037ull;
+        };
+    }
+
+    //ActionRecorder
+    ActionRecorder::~ActionRecorder() {
+        Flush();
+    }
+
+    void ActionRecorder::Open(const std::filesystem::path& file_path, uint64_t seed) {
+        file_.open(file_path, std::ios::binary | std::ios::trunc);
+        if (!file_.is_open())
+            throw std::runtime_error("Failed to open record file: " + file_path.string());
+        buffer_.append(std::begin(record::MAGIC), std::end(record::MAGIC));
+        buffer_.push_back(static_cast<char>(record::FORMAT_VERSION));
+        PutKind(record::EventKind::SEED);
+        PutVarint(seed);
+        Flush();
+    }
+
+    void ActionRecorder::RecordJoin(const Token& token, const std::string& user_name, const std::string& map_id) {
+        if (!IsOpen())
+            return;
+        uint64_t index = TokenIndex(token);
+        PutKind(record::EventKind::JOIN);
+        PutVarint(index);
+        PutString(user_name);
+        PutString(map_id);
+    }
+
+    void ActionRecorder::RecordAction(const Token& token, const std::string& direction) {
+        if (!IsOpen())
+            return;
+        uint64_t index = TokenIndex(token);
+        PutKind(record::EventKind::ACTION);
+        PutVarint(index);
+        buffer_.push_back(direction.empty() ? '\0' : direction.front());
+    }
+
+    void ActionRecorder::RecordTick(std::chrono::milliseconds time_delta) {
+        if (!IsOpen())
+            return;
+        PutKind(record::EventKind::TICK);
+        PutVarint(static_cast<uint64_t>(time_delta.count()));
+        if (buffer_.size() >= FLUSH_THRESHOLD)
+            Flush();
+    }
+
+    void ActionRecorder::RecordRetirement(const std::vector<model::Dog::Id>& dog_ids) {
+        if (!IsOpen() || dog_ids.empty())
+            return;
+        PutKind(record::EventKind::RETIREMENT);
+        PutVarint(dog_ids.size());
+        for (auto id : dog_ids)
+            PutVarint(id);
+    }
+
+    void ActionRecorder::Close(const model::Game& game) {
+        if (!IsOpen())
+            return;
+        PutKind(record::EventKind::DIGEST);
+        PutVarint(StateDigest(game));
+        Flush();
+        file_.close();
+    }
+
+    uint64_t ActionRecorder::TokenIndex(const Token& token) {
+        auto it = token_to_index_.find(token);
+        if (it != token_to_index_.end())
+            return it->second;
+        uint64_t index = token_to_index_.size();
+        token_to_index_.emplace(token, index);
+        PutKind(record::EventKind::TOKEN);
+        PutString(token);
+        return index;
+    }
+
+    void ActionRecorder::PutKind(record::EventKind kind) {
+        buffer_.push_back(static_cast<char>(kind));
+    }
+
+    void ActionRecorder::PutVarint(uint64_t value) {
+        while (value >= 0x80) {
+            buffer_.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        buffer_.push_back(static_cast<char>(value));
+    }
+
+    void ActionRecorder::PutString(const std::string& str) {
+        PutVarint(str.size());
+        buffer_ += str;
+    }
+
+    void ActionRecorder::Flush() {
+        if (file_.is_open() && !buffer_.empty()) {
+            file_.write(buffer_.data(), buffer_.size());
+            file_.flush();
+        }
+        buffer_.clear();
+    }
+
+    //ActionReader
+    ActionReader::ActionReader(const std::filesystem::path& file_path) {
+        std::ifstream file(file_path, std::ios::binary);
+        if (!file.is_open())
+            throw std::runtime_error("Failed to open record file: " + file_path.string());
+        std::stringstream ss;
+        ss << file.rdbuf();
+        data_ = ss.str();
+
+        if (data_.size() < sizeof(record::MAGIC) + 1 || data_.compare(0, sizeof(record::MAGIC), record::MAGIC, sizeof(record::MAGIC)) != 0)
+            throw std::runtime_error("Not a record file: " + file_path.string());
+        if (static_cast<uint8_t>(data_[sizeof(record::MAGIC)]) != record::FORMAT_VERSION)
+            throw std::runtime_error("Unsupported record format version");
+        position_ = sizeof(record::MAGIC) + 1;
+    }
+
+    std::optional<record::Event> ActionReader::Next() {
+        while (position_ < data_.size()) {
+            auto kind = static_cast<record::EventKind>(data_[position_++]);
+            switch (kind) {
+            case record::EventKind::SEED:
+                return record::Seed{ GetVarint() };
+            case record::EventKind::TOKEN:
+                tokens_.push_back(GetString());
+                break;
+            case record::EventKind::JOIN: {
+                record::Join join;
+                join.token = GetToken();
+                join.user_name = GetString();
+                join.map_id = GetString();
+                return join;
+            }
+            case record::EventKind::ACTION: {
+                record::Action action;
+                action.token = GetToken();
+                if (position_ >= data_.size())
+                    throw std::runtime_error("Truncated record file");
+                char dir = data_[position_++];
+                if (dir != '\0')
+                    action.direction.push_back(dir);
+                return action;
+            }
+            case record::EventKind::TICK:
+                return record::Tick{ std::chrono::milliseconds(GetVarint()) };
+            case record::EventKind::RETIREMENT: {
+                record::Retirement retirement;
+                retirement.dog_ids.resize(GetVarint());
+                for (auto& id : retirement.dog_ids)
+                    id = GetVarint();
+                return retirement;
+            }
+            case record::EventKind::DIGEST:
+                return record::Digest{ GetVarint() };
+            default:
+                throw std::runtime_error("Unknown event in record file");
+            }
+        }
+        return std::nullopt;
+    }
+
+    uint64_t ActionReader::GetVarint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (position_ >= data_.size())
+                throw std::runtime_error("Truncated record file");
+            auto byte = static_cast<uint8_t>(data_[position_++]);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        throw std::runtime_error("Malformed varint in record file");
+    }
+
+    std::string ActionReader::GetString() {
+        uint64_t size = GetVarint();
+        if (size > data_.size() - position_)
+            throw std::runtime_error("Truncated record file");
+        std::string str = data_.substr(position_, size);
+        position_ += size;
+        return str;
+    }
+
+    const Token& ActionReader::GetToken() {
+        uint64_t index = GetVarint();
+        if (index >= tokens_.size())
+            throw std::runtime_error("Unknown token index in record file");
+        return tokens_[index];
+    }
+
+    uint64_t StateDigest(const model::Game& game) {
+        Fnv1a hash;
+        for (auto& session : game.GetGameSessions()) {
+            hash.Add(*session->GetMapId());
+            for (auto& [name, dog] : session->GetDogs()) {
+                hash.Add(dog->GetId());
+                hash.Add(dog->GetPosition().x);
+                hash.Add(dog->GetPosition().y);
+                hash.Add(dog->GetSpeed().s_x);
+                hash.Add(dog->GetSpeed().s_y);
+                hash.Add(dog->GetDirection());
+                hash.Add(dog->GetScore());
+                for (auto& [id, object] : dog->GetBag()) {
+                    hash.Add(id);
+                    hash.Add(object.type);
+                }
+            }
+            for (auto& [id, object] : session->GetCurrentLostObjects()) {
+                hash.Add(id);
+                hash.Add(object.type);
+                hash.Add(object.position.x);
+                hash.Add(object.position.y);
+            }
+        }
+        return hash.Get();
+    }
+}
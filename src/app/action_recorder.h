@@ -0,0 +1,101 @@
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "../model/model.h"
+
+namespace app {
+    using Token = std::string;
+
+    //binary log of every input that changes the game state; a replay of the log gives the same state
+    //
+    //file: "GSRL", format version (1 byte), then events; an event is its kind (1 byte) and a payload
+    //of varints and length-prefixed strings. Tokens are written once and then referred to by index.
+    namespace record {
+        enum class EventKind : uint8_t {
+            SEED = 1,       // seed
+            TOKEN = 2,      // token            (gives the token the next index)
+            JOIN = 3,       // token index, user name, map id
+            ACTION = 4,     // token index, direction character ('\0' stands for "stop")
+            TICK = 5,       // time delta in milliseconds
+            RETIREMENT = 6, // count, dog ids
+            DIGEST = 7      // state digest at the end of the recording
+        };
+
+        struct Seed { uint64_t seed; };
+        struct Join { Token token; std::string user_name; std::string map_id; };
+        struct Action { Token token; std::string direction; };
+        struct Tick { std::chrono::milliseconds time_delta; };
+        struct Retirement { std::vector<model::Dog::Id> dog_ids; };
+        struct Digest { uint64_t digest; };
+
+        using Event = std::variant<Seed, Join, Action, Tick, Retirement, Digest>;
+
+        constexpr char MAGIC[] = { 'G', 'S', 'R', 'L' };
+        constexpr uint8_t FORMAT_VERSION = 1;
+    }
+
+    //writes the log; all calls come from the game strand. A recorder that was not opened ignores everything
+    class ActionRecorder {
+    public:
+        ActionRecorder() = default;
+        ActionRecorder(const ActionRecorder&) = delete;
+        ActionRecorder& operator=(const ActionRecorder&) = delete;
+        ~ActionRecorder();
+
+        void Open(const std::filesystem::path& file_path, uint64_t seed);
+
+        bool IsOpen() const {
+            return file_.is_open();
+        }
+
+        void RecordJoin(const Token& token, const std::string& user_name, const std::string& map_id);
+
+        void RecordAction(const Token& token, const std::string& direction);
+
+        void RecordTick(std::chrono::milliseconds time_delta);
+
+        void RecordRetirement(const std::vector<model::Dog::Id>& dog_ids);
+
+        //writes the digest of the final state and closes the file
+        void Close(const model::Game& game);
+
+    private:
+        uint64_t TokenIndex(const Token& token);
+        void PutKind(record::EventKind kind);
+        void PutVarint(uint64_t value);
+        void PutString(const std::string& str);
+        void Flush();
+
+        std::ofstream file_;
+        std::string buffer_;
+        std::unordered_map<Token, uint64_t> token_to_index_;
+    };
+
+    //reads the log written by ActionRecorder
+    class ActionReader {
+    public:
+        explicit ActionReader(const std::filesystem::path& file_path);
+
+        //returns std::nullopt at the end of the log
+        std::optional<record::Event> Next();
+
+    private:
+        uint64_t GetVarint();
+        std::string GetString();
+        const Token& GetToken();
+
+        std::string data_;
+        size_t position_ = 0;
+        std::vector<Token> tokens_;
+    };
+
+    //hash of everything the simulation changes: dogs (position, speed, direction, bag, score) and lost objects
+    uint64_t StateDigest(const model::Game& game);
+}
@@ -79,6 +79,29 @@ namespace app {
         return answer;
     }
 
+    bool Player::Move(const std::string& dir) {
+        double dog_speed = game_session_->GetDogSpeed();
+        if (dir == "L")
+            SetDogSpeed(-dog_speed, 0.);
+        else if (dir == "R")
+            SetDogSpeed(dog_speed, 0.);
+        else if (dir == "U")
+            SetDogSpeed(0., -dog_speed);
+        else if (dir == "D")
+            SetDogSpeed(0., dog_speed);
+        else if (dir == "") {
+            SetDogSpeed(0., 0.);
+            SetDogDirection("U");
+            game_session_->InvalidateStateSnapshot();
+            return true;
+        }
+        else
+            return false;
+        SetDogDirection(dir);
+        game_session_->InvalidateStateSnapshot();
+        return true;
+    }
+
     void Player::CheckRetirementTime(double time_delta) {
         if (dog_->GetSpeed().s_x == 0. && dog_->GetSpeed().s_y == 0.)
             dog_->IncreaceDownTime(time_delta);
@@ -106,23 +129,33 @@ namespace app {
 
     }
 
-	Token PlayerTokens::GenerateToken() {
-        std::stringstream ss;
-        ss << std::hex << generator1_();
-        ss << std::hex << generator2_();
-        while (ss.str().size() < 32)
-            ss << rand() % 9;
-        return ss.str();
-	}
+    std::pair<Token, std::shared_ptr<Player>> JoinGame(model::Game& game, Players& players, PlayerTokens& tokens,
+                                                       const std::string& user_name, const model::Map::Id& map_id,
+                                                       std::optional<Token> token) {
+        //looking for (creating) game sessions
+        std::shared_ptr<model::GameSession> gs = game.FindGameSession(map_id);
+        //creating dog; creating player for that dog and that game session; creating token for that player
+        auto player = players.Add(std::make_shared<model::Dog>(user_name), gs);
+        if (token)
+            tokens.AddPlayer(*token, player);
+        else
+            token = tokens.AddPlayer(player);
+        player->SetRetirementTime(game.GetDogRetirementTime() * 1000);
+        gs->GenerateForced();
+        gs->InvalidateStateSnapshot();
+        return { *token, player };
+    }
 
     void GameTimer::Tick(std::chrono::milliseconds time_delta) {
         boost::asio::dispatch(strand_, [this, time_delta]() {
+            recorder_.RecordTick(time_delta);
             players_.MoveAllDogs(std::chrono::duration<double>(time_delta).count() * CLOCKS_PER_SEC);
             players_.IncreaseAllTimes(std::chrono::duration<double>(time_delta).count());
             auto list_id_for_deletion = tokens_.CheckRetirementTime();
+            recorder_.RecordRetirement(list_id_for_deletion);
 
-            for (int i = 0; i < game_sessions_.size(); ++i)
-                database_.AddRecordsAllDogs(*game_sessions_[i], list_id_for_deletion);
+            for (int i = 0; database_ && i < game_sessions_.size(); ++i)
+                database_->AddRecordsAllDogs(*game_sessions_[i], list_id_for_deletion);
 
             for (int i = 0; i < game_sessions_.size(); ++i)
                 game_sessions_[i]->DeleteDogs(list_id_for_deletion);
@@ -134,8 +167,11 @@ namespace app {
                 game_sessions_[i]->CollectionItems(std::chrono::duration<double>(time_delta).count() * CLOCKS_PER_SEC);
                 game_sessions_[i]->LeaveItems(std::chrono::duration<double>(time_delta).count() * CLOCKS_PER_SEC);
             }
-            app_listener_.OnTick(std::chrono::duration<double>(time_delta).count() * CLOCKS_PER_SEC);
 
+            for (int i = 0; i < game_sessions_.size(); ++i)
+                game_sessions_[i]->RecordHistory();
+            app_listener_.OnTick(std::chrono::duration<double>(time_delta).count() * CLOCKS_PER_SEC);
+            last_retired_ = std::move(list_id_for_deletion);
         });
     }
 }
\ No newline at end of file
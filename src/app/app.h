@@ -1,6 +1,8 @@
 #pragma once
 #include <memory>
+#include <optional>
 #include <random>
+#include <shared_mutex>
 #include <unordered_map>
 #include <iostream>
 
@@ -14,6 +16,8 @@
 
 #include "../model/model.h"
 #include "../database_tools/postgres.h"
+#include "action_recorder.h"
+#include "token_map.h"
 
 namespace app {
     using Token = std::string;
@@ -56,6 +60,9 @@ namespace app {
             dog_->SetDirection(dir);
         }
 
+        //applies the "move" command ("L", "R", "U", "D" or "" to stop); false if the command is unknown
+        bool Move(const std::string& dir);
+
         std::vector<model::Road> GetRoadsWithDog();
 
         model::Position NewCorrectPosition(model::Position new_position);
@@ -96,49 +103,52 @@ namespace app {
 	};
 
     //contains the pairs player-tocken 
+    //changed on the game strand only; FindPlayerByToken may be called from any thread
     class PlayerTokens {  
     public:
         Token AddPlayer(std::shared_ptr<Player> player) {
-            Token token = GenerateToken();
-            token_to_player_[token] = player;
-            return token;
+            Token128 token{ generator1_(), generator2_() };
+            index_.Insert(token, std::move(player));
+            return token.ToString();
         }
 
+        //"token" has to be 32 lowercase hex digits, as the generated ones are
         void AddPlayer(Token token, std::shared_ptr<Player> player) {
-            token_to_player_[token] = player;
+            auto parsed = Token128::Parse(token);
+            if (!parsed)
+                throw std::invalid_argument("Malformed token " + token);
+            index_.Insert(*parsed, std::move(player));
+        }
+
+        std::shared_ptr<Player> FindPlayerByToken(const Token128& token) const {
+            return index_.Find(token);
         }
 
-        std::shared_ptr<Player> FindPlayerByToken(const Token& token) {
-            auto player = token_to_player_.find(token);
-            if (player != token_to_player_.end())
-                return player->second;
-            return nullptr;
+        std::shared_ptr<Player> FindPlayerByToken(std::string_view token) const {
+            auto parsed = Token128::Parse(token);
+            return parsed ? index_.Find(*parsed) : nullptr;
         }
 
         std::unordered_map<Token, std::shared_ptr<Player>> GetTokens() const {
-            return token_to_player_;
+            std::unordered_map<Token, std::shared_ptr<Player>> tokens;
+            index_.ForEach([&tokens](const Token128& token, const std::shared_ptr<Player>& player) {
+                tokens.emplace(token.ToString(), player);
+                });
+            return tokens;
         }
 
         std::vector<model::Dog::Id> CheckRetirementTime() {
+            auto retired = index_.EraseIf([](const std::shared_ptr<Player>& player) {
+                return player->GetDownTime() >= player->GetRetirementTime();
+                });
             std::vector<model::Dog::Id> list_of_id_for_dog_deletion;
-            std::vector<Token> tokens_for_deletion;
-            for (auto& p : token_to_player_)
-                if (p.second->GetDownTime() >= p.second->GetRetirementTime())
-                    tokens_for_deletion.push_back(p.first);
-            for (auto& p : tokens_for_deletion) {
-                list_of_id_for_dog_deletion.push_back(token_to_player_[p]->GetDogId());
-                token_to_player_.erase(p);
-            }
+            for (auto& player : retired)
+                list_of_id_for_dog_deletion.push_back(player->GetDogId());
             return list_of_id_for_dog_deletion;
         }
 
-        template <typename Archive>
-        void serialize(Archive& ar, [[maybe_unused]] const unsigned int version) {
-            ar& token_to_player_;
-        }
-
     private:
-        std::unordered_map<Token, std::shared_ptr<Player>> token_to_player_;
+        TokenMap<std::shared_ptr<Player>> index_;
         std::random_device random_device_;
         std::mt19937_64 generator1_{ [this] {
             std::uniform_int_distribution<std::mt19937_64::result_type> dist;
@@ -148,7 +158,6 @@ namespace app {
             std::uniform_int_distribution<std::mt19937_64::result_type> dist;
             return dist(random_device_);
         }() };
-        Token GenerateToken();
     };
 
     //contains the all players
@@ -180,6 +189,11 @@ namespace app {
         std::unordered_map<std::pair<uint64_t, std::string>, std::shared_ptr<Player>, boost::hash<std::pair<uint64_t, std::string>>> players_;
     };
 
+    //creates the dog and its player in the game session of "map_id"; the token is generated unless it is given
+    std::pair<Token, std::shared_ptr<Player>> JoinGame(model::Game& game, Players& players, PlayerTokens& tokens,
+                                                       const std::string& user_name, const model::Map::Id& map_id,
+                                                       std::optional<Token> token = std::nullopt);
+
     //to manage the game clock
     class ApplicationListener {
     public:
@@ -197,11 +211,19 @@ namespace app {
     class GameTimer {
     public:
 
+        //"database" gets the records of retired dogs; nullptr - they are not saved (e.g. in a replay)
         GameTimer(Players& players, PlayerTokens& player_tokens, const model::Game::GameSessions& game_sessions,
-                  boost::asio::strand<boost::asio::io_context::executor_type>& strand, ApplicationListener& app_listener, postgres_tools::PostgresDatabase& database) :
-            players_(players), tokens_(player_tokens), game_sessions_(game_sessions), strand_(strand), app_listener_(app_listener), database_(database) {}
+                  boost::asio::strand<boost::asio::io_context::executor_type>& strand, ApplicationListener& app_listener, postgres_tools::PostgresDatabase* database,
+                  ActionRecorder& recorder) :
+            players_(players), tokens_(player_tokens), game_sessions_(game_sessions), strand_(strand), app_listener_(app_listener), database_(database),
+            recorder_(recorder) {}
 
         void Tick(std::chrono::milliseconds time_delta);
+
+        //dogs retired by the last tick
+        const std::vector<model::Dog::Id>& GetLastRetired() const {
+            return last_retired_;
+        }
     private:
         Players& players_;
         PlayerTokens& tokens_;
@@ -211,7 +233,10 @@ namespace app {
         boost::asio::strand<boost::asio::io_context::executor_type>& strand_;
 
         ApplicationListener& app_listener_;
-        postgres_tools::PostgresDatabase& database_;
+        postgres_tools::PostgresDatabase* database_;
+        ActionRecorder& recorder_;
+
+        std::vector<model::Dog::Id> last_retired_;
     };
     
  
@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <optional>
+#include <utility>
+
+namespace app {
+
+    //unbounded lock-free queue of many producers and one consumer (D. Vyukov's intrusive MPSC list): Push is
+    //one atomic exchange, Pop touches no shared counter. A value pushed by a producer that was preempted
+    //halfway may hold back the values pushed after it until that producer goes on; Pop reports empty then
+    template <typename T>
+    class MpscQueue {
+    public:
+        MpscQueue() {
+            auto stub = new Node;
+            head_.store(stub, std::memory_order_relaxed);
+            tail_ = stub;
+        }
+
+        MpscQueue(const MpscQueue&) = delete;
+        MpscQueue& operator=(const MpscQueue&) = delete;
+
+        ~MpscQueue() {
+            while (Pop()) {
+            }
+            delete tail_;
+        }
+
+        //any thread
+        void Push(T value) {
+            auto node = new Node;
+            node->value.emplace(std::move(value));
+            auto prev = head_.exchange(node, std::memory_order_acq_rel);
+            prev->next.store(node, std::memory_order_release);
+        }
+
+        //the consumer thread only
+        std::optional<T> Pop() {
+            Node* tail = tail_;
+            Node* next = tail->next.load(std::memory_order_acquire);
+            if (!next)
+                return std::nullopt;
+            //"next" becomes the new stub; its value moves out
+            tail_ = next;
+            std::optional<T> value = std::move(next->value);
+            next->value.reset();
+            delete tail;
+            return value;
+        }
+
+    private:
+        struct Node {
+            std::atomic<Node*> next = nullptr;
+            std::optional<T> value;
+        };
+
+        alignas(64) std::atomic<Node*> head_;
+        alignas(64) Node* tail_;
+    };
+
+}  // namespace app
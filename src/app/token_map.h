@@ -0,0 +1,125 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace app {
+
+    //token as 128 bits: compared and hashed without touching the 32-char string
+    struct Token128 {
+        uint64_t hi = 0;
+        uint64_t lo = 0;
+
+        //std::nullopt unless "token" is exactly 32 lowercase hex digits
+        static std::optional<Token128> Parse(std::string_view token) {
+            if (token.size() != 32)
+                return std::nullopt;
+            Token128 result;
+            for (size_t i = 0; i < 32; ++i) {
+                char c = token[i];
+                uint64_t digit = 0;
+                if (c >= '0' && c <= '9')
+                    digit = c - '0';
+                else if (c >= 'a' && c <= 'f')
+                    digit = c - 'a' + 10;
+                else
+                    return std::nullopt;
+                uint64_t& half = i < 16 ? result.hi : result.lo;
+                half = (half << 4) | digit;
+            }
+            return result;
+        }
+
+        std::string ToString() const {
+            static constexpr char DIGITS[] = "0123456789abcdef";
+            std::string result(32, '0');
+            for (size_t i = 0; i < 16; ++i) {
+                result[15 - i] = DIGITS[(hi >> (4 * i)) & 0xf];
+                result[31 - i] = DIGITS[(lo >> (4 * i)) & 0xf];
+            }
+            return result;
+        }
+
+        bool operator==(const Token128&) const = default;
+
+        struct Hash {
+            size_t operator()(const Token128& token) const {
+                //tokens are random, any mix of the halves will do
+                return static_cast<size_t>(token.lo ^ (token.hi * 0x9e3779b97f4a7c15ull));
+            }
+        };
+    };
+
+    //token -> value map for many readers on any thread and rare writers: the tokens are spread over SHARDS
+    //maps with their own locks, so lookups of the io threads hardly ever wait for each other or for a writer
+    template <typename Value>
+    class TokenMap {
+    public:
+        static constexpr size_t SHARDS = 16;
+
+        //default Value if there is no such token
+        Value Find(const Token128& token) const {
+            auto& shard = ShardOf(token);
+            std::shared_lock lock(shard.mutex);
+            auto it = shard.values.find(token);
+            return it == shard.values.end() ? Value{} : it->second;
+        }
+
+        void Insert(const Token128& token, Value value) {
+            auto& shard = ShardOf(token);
+            std::unique_lock lock(shard.mutex);
+            shard.values[token] = std::move(value);
+        }
+
+        //calls "fn(token, value)" for every entry; shard by shard, so this is not a snapshot of the whole index
+        template <typename Fn>
+        void ForEach(Fn&& fn) const {
+            for (auto& shard : shards_) {
+                std::shared_lock lock(shard.mutex);
+                for (auto& [token, value] : shard.values)
+                    fn(token, value);
+            }
+        }
+
+        //removes the entries "pred(value)" is true for and returns their values
+        template <typename Pred>
+        std::vector<Value> EraseIf(Pred&& pred) {
+            std::vector<Value> erased;
+            for (auto& shard : shards_) {
+                std::unique_lock lock(shard.mutex);
+                std::erase_if(shard.values, [&](const auto& item) {
+                    if (!pred(item.second))
+                        return false;
+                    erased.push_back(item.second);
+                    return true;
+                    });
+            }
+            return erased;
+        }
+
+    private:
+        //a shard per cache line, so readers of different shards do not share one
+        struct alignas(64) Shard {
+            mutable std::shared_mutex mutex;
+            std::unordered_map<Token128, Value, Token128::Hash> values;
+        };
+
+        Shard& ShardOf(const Token128& token) {
+            return shards_[token.lo % SHARDS];
+        }
+
+        const Shard& ShardOf(const Token128& token) const {
+            return shards_[token.lo % SHARDS];
+        }
+
+        std::array<Shard, SHARDS> shards_;
+    };
+
+}  // namespace app
@@ -0,0 +1,201 @@
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "../model/model.h"
+#include "../model/loot_generator.h"
+#include "../model/collision_detector.h"
+#include "../app/app.h"
+
+namespace {
+
+    constexpr int64_t MIN_COUNT = 10;
+    constexpr int64_t MAX_COUNT = 100'000;
+
+    // GameSession::GetDog walks the multimap from the beginning, so CollectionItems and LeaveItems
+    // are quadratic in the number of dogs; their dog sweeps stop earlier to keep a run in minutes
+    constexpr int64_t MAX_DOGS_QUADRATIC = 1'000;
+    constexpr int64_t MAX_DOGS_LEAVE = 10'000;
+
+    constexpr int64_t DEFAULT_DOGS = 10;
+    constexpr int64_t DEFAULT_ROADS = 20;
+    constexpr double TIME_DELTA_MS = 50.;
+
+    model::LootGeneratorParams LOOT_PARAMS{ 5.0, 0.5 };
+
+    //synthetic map: a square grid of "roads_count" roads (half horizontal, half vertical) with one office
+    model::Map MakeGridMap(int64_t roads_count) {
+        model::Map map(model::Map::Id("bench_map_" + std::to_string(roads_count)), "Bench map");
+        const model::Coord lines = std::max<model::Coord>(1, roads_count / 2);
+        const model::Coord step = 10;
+        const model::Coord length = lines * step;
+        for (model::Coord i = 0; i < lines; ++i) {
+            map.AddRoad(model::Road(model::Road::HORIZONTAL, { 0, i * step }, length));
+            map.AddRoad(model::Road(model::Road::VERTICAL, { i * step, 0 }, length));
+        }
+        map.AddOffice(model::Office(model::Office::Id("o0"), { length, 0 }, { 0, 0 }));
+        map.SetDogSpeed(3.);
+        map.SetMaxCountOfLootObjects(2);
+        map.GetPriceList()[0] = 10;
+        map.GetPriceList()[1] = 30;
+        map.SetBagCapacity(3);
+        return map;
+    }
+
+    //adds "dogs_count" dogs, all of them running east along the first road
+    std::vector<std::shared_ptr<model::Dog>> AddRunningDogs(model::GameSession& session, int64_t dogs_count) {
+        std::vector<std::shared_ptr<model::Dog>> dogs;
+        dogs.reserve(dogs_count);
+        for (int64_t i = 0; i < dogs_count; ++i) {
+            auto dog = std::make_shared<model::Dog>("dog_" + std::to_string(i));
+            session.AddDog(dog);
+            dog->SetSpeed({ 3., 0. });
+            dogs.push_back(std::move(dog));
+        }
+        return dogs;
+    }
+
+    //lost objects placed off the road, so collision math runs for every pair but nothing gets collected
+    void AddUnreachableItems(model::GameSession& session, int64_t items_count) {
+        for (int64_t i = 0; i < items_count; ++i) {
+            session.PushLostObject({ 0, { static_cast<double>(i % 100), 5. }, 10 });
+        }
+    }
+
+    void BM_TryCollectPoint(benchmark::State& state) {
+        const int64_t items_count = state.range(0);
+        std::vector<collision_detector::Point> items;
+        items.reserve(items_count);
+        for (int64_t i = 0; i < items_count; ++i)
+            items.push_back({ static_cast<double>(i % 1000), static_cast<double>(i % 7) * 0.1 });
+
+        for (auto _ : state) {
+            size_t collected = 0;
+            for (const auto& item : items) {
+                auto result = collision_detector::TryCollectPoint({ 0., 0. }, { 1000., 0. }, item);
+                collected += result.IsCollected(model::WIDTH_OF_DOG);
+            }
+            benchmark::DoNotOptimize(collected);
+        }
+        state.SetItemsProcessed(state.iterations() * items_count);
+    }
+    BENCHMARK(BM_TryCollectPoint)->RangeMultiplier(10)->Range(MIN_COUNT, MAX_COUNT);
+
+    void BM_CollectionItems(benchmark::State& state) {
+        const int64_t dogs_count = state.range(0);
+        const int64_t items_count = state.range(1);
+        model::Map map = MakeGridMap(DEFAULT_ROADS);
+        model::GameSession session(map, false, LOOT_PARAMS);
+        auto dogs = AddRunningDogs(session, dogs_count);
+        AddUnreachableItems(session, items_count);
+
+        for (auto _ : state) {
+            session.CollectionItems(TIME_DELTA_MS);
+        }
+        state.SetItemsProcessed(state.iterations() * dogs_count * items_count);
+    }
+    BENCHMARK(BM_CollectionItems)
+        ->ArgsProduct({ benchmark::CreateRange(MIN_COUNT, MAX_DOGS_QUADRATIC, 10), { DEFAULT_DOGS } })
+        ->ArgsProduct({ { DEFAULT_DOGS }, benchmark::CreateRange(MIN_COUNT * 10, MAX_COUNT, 10) })
+        ->Unit(benchmark::kMicrosecond);
+
+    void BM_LeaveItems(benchmark::State& state) {
+        const int64_t dogs_count = state.range(0);
+        model::Map map = MakeGridMap(DEFAULT_ROADS);
+        model::GameSession session(map, false, LOOT_PARAMS);
+        auto dogs = AddRunningDogs(session, dogs_count);
+
+        for (auto _ : state) {
+            session.LeaveItems(TIME_DELTA_MS);
+        }
+        state.SetItemsProcessed(state.iterations() * dogs_count);
+    }
+    BENCHMARK(BM_LeaveItems)->RangeMultiplier(10)->Range(MIN_COUNT, MAX_DOGS_LEAVE)->Unit(benchmark::kMicrosecond);
+
+    void BM_GenerateLoot(benchmark::State& state) {
+        const int64_t dogs_count = state.range(0);
+        model::Map map = MakeGridMap(DEFAULT_ROADS);
+        model::GameSession session(map, false, LOOT_PARAMS);
+        auto dogs = AddRunningDogs(session, dogs_count);
+
+        for (auto _ : state) {
+            session.GenerateLoot(std::chrono::milliseconds(60'000));
+            state.PauseTiming();
+            session.GetCurrentLostObjects().clear();
+            state.ResumeTiming();
+        }
+        state.SetItemsProcessed(state.iterations() * dogs_count);
+    }
+    BENCHMARK(BM_GenerateLoot)->RangeMultiplier(10)->Range(MIN_COUNT, MAX_COUNT)->Unit(benchmark::kMicrosecond);
+
+    void BM_MoveDog(benchmark::State& state) {
+        const int64_t dogs_count = state.range(0);
+        model::Map map = MakeGridMap(DEFAULT_ROADS);
+        auto session = std::make_shared<model::GameSession>(map, false, LOOT_PARAMS);
+        std::vector<std::shared_ptr<app::Player>> players;
+        players.reserve(dogs_count);
+        for (int64_t i = 0; i < dogs_count; ++i)
+            players.push_back(std::make_shared<app::Player>(std::make_shared<model::Dog>("dog_" + std::to_string(i)), session));
+
+        double speed = map.GetDogSpeed();
+        for (auto _ : state) {
+            //run back and forth so that dogs never get stuck at the end of the road
+            speed = -speed;
+            for (auto& player : players) {
+                player->SetDogSpeed(speed, 0.);
+                player->MoveDog(TIME_DELTA_MS);
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * dogs_count);
+    }
+    BENCHMARK(BM_MoveDog)->RangeMultiplier(10)->Range(MIN_COUNT, MAX_COUNT)->Unit(benchmark::kMicrosecond);
+
+    void BM_NewCorrectPosition(benchmark::State& state) {
+        const int64_t roads_count = state.range(0);
+        model::Map map = MakeGridMap(roads_count);
+        auto session = std::make_shared<model::GameSession>(map, false, LOOT_PARAMS);
+        app::Player player(std::make_shared<model::Dog>("dog"), session);
+        player.SetDogDirection("R");
+
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(player.NewCorrectPosition({ 1000., 0.1 }));
+        }
+        state.SetItemsProcessed(state.iterations() * roads_count);
+    }
+    BENCHMARK(BM_NewCorrectPosition)->RangeMultiplier(10)->Range(MIN_COUNT, MAX_COUNT);
+
+    void BM_LootGenerator(benchmark::State& state) {
+        const unsigned looters_count = static_cast<unsigned>(state.range(0));
+        loot_gen::LootGenerator generator(5s, 0.5);
+
+        unsigned loot_count = 0;
+        for (auto _ : state) {
+            loot_count += generator.Generate(1s, loot_count % looters_count, looters_count);
+            benchmark::DoNotOptimize(loot_count);
+        }
+    }
+    BENCHMARK(BM_LootGenerator)->RangeMultiplier(10)->Range(MIN_COUNT, MAX_COUNT);
+
+}  // namespace
+
+//results are printed as JSON unless another format is requested, so runs can be stored and compared
+int main(int argc, char** argv) {
+    std::vector<char*> args(argv, argv + argc);
+    std::string json_format = "--benchmark_format=json";
+    bool has_format = false;
+    for (int i = 1; i < argc; ++i)
+        if (std::string_view(argv[i]).starts_with("--benchmark_format"))
+            has_format = true;
+    if (!has_format)
+        args.push_back(json_format.data());
+    int args_count = static_cast<int>(args.size());
+
+    benchmark::Initialize(&args_count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(args_count, args.data()))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
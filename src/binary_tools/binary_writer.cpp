@@ -0,0 +1,87 @@
+#include "binary_writer.h"
+
+namespace binary_writer {
+
+	namespace {
+		uint8_t DirectionCode(model::Direction direction) {
+			switch (direction) {
+			case model::Direction::NORTH:
+				return 0;
+			case model::Direction::SOUTH:
+				return 1;
+			case model::Direction::WEST:
+				return 2;
+			case model::Direction::EAST:
+				return 3;
+			}
+			return 0;
+		}
+	}
+
+	void WriteGameState(BinaryWriter& writer, const model::GameSession& session) {
+		writer.Header(Message::State);
+		writer.Varint(session.GetDogs().size());
+		for (auto& [name, dog] : session.GetDogs()) {
+			writer.Varint(dog->GetId());
+			writer.Coordinate(dog->GetPosition().x);
+			writer.Coordinate(dog->GetPosition().y);
+			writer.Coordinate(dog->GetSpeed().s_x);
+			writer.Coordinate(dog->GetSpeed().s_y);
+			writer.Byte(DirectionCode(dog->GetDirection()));
+			writer.Varint(dog->GetBag().size());
+			for (auto& [id, object] : dog->GetBag()) {
+				writer.Varint(id);
+				writer.Varint(object.type);
+			}
+			writer.Signed(dog->GetScore());
+		}
+		const auto& lost_objects = session.GetCurrentLostObjects();
+		writer.Varint(lost_objects.size());
+		for (auto& [id, object] : lost_objects) {
+			writer.Varint(id);
+			writer.Varint(object.type);
+			writer.Coordinate(object.position.x);
+			writer.Coordinate(object.position.y);
+		}
+	}
+
+	void WritePlayers(BinaryWriter& writer, const model::GameSession& session) {
+		writer.Header(Message::Players);
+		writer.Varint(session.GetDogs().size());
+		for (auto& [name, dog] : session.GetDogs()) {
+			writer.Varint(dog->GetId());
+			writer.String(dog->GetName());
+		}
+	}
+
+	void WriteMap(BinaryWriter& writer, const model::Map& map, std::string_view loot_types_json) {
+		writer.Header(Message::Map);
+		writer.String(*map.GetId());
+		writer.String(map.GetName());
+		writer.Varint(map.GetRoads().size());
+		for (auto& road : map.GetRoads()) {
+			writer.Varint(road.GetStart().x);
+			writer.Varint(road.GetStart().y);
+			writer.Byte(road.IsHorizontal());
+			writer.Varint(road.IsHorizontal() ? road.GetEnd().x : road.GetEnd().y);
+		}
+		writer.Varint(map.GetBuildings().size());
+		for (auto& building : map.GetBuildings()) {
+			writer.Varint(building.GetBounds().position.x);
+			writer.Varint(building.GetBounds().position.y);
+			writer.Varint(building.GetBounds().size.width);
+			writer.Varint(building.GetBounds().size.height);
+		}
+		writer.Varint(map.GetOffices().size());
+		for (auto& office : map.GetOffices()) {
+			writer.String(*office.GetId());
+			writer.Varint(office.GetPosition().x);
+			writer.Varint(office.GetPosition().y);
+			//offsets may be negative; they are kept as unsigned numbers
+			writer.Signed(static_cast<int64_t>(office.GetOffset().dx));
+			writer.Signed(static_cast<int64_t>(office.GetOffset().dy));
+		}
+		writer.String(loot_types_json);
+	}
+
+}   // namespace binary_writer
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "../model/model.h"
+
+//compact binary answers of the game API for clients that send "Accept: application/x-gameserver-binary".
+//Schema, version 1 (all integers are LEB128 varints, signed ones zigzag-encoded first):
+//  message     := version:u8 kind:u8 body
+//  string      := length bytes
+//  coordinate  := signed, in units of QUANTUM
+//  State (1)   := count { id x:coordinate y:coordinate sx:coordinate sy:coordinate dir:u8(U,D,L,R) count { id type } score:signed }
+//                 count { id type x:coordinate y:coordinate }
+//  Players (2) := count { id name:string }
+//  Map (3)     := id:string name:string count { x0 y0 horizontal:u8 end } count { x y w h }
+//                 count { id:string x y offsetX:signed offsetY:signed } lootTypes:string(json text)
+namespace binary_writer {
+
+	constexpr std::string_view CONTENT_TYPE = "application/x-gameserver-binary";
+
+	constexpr uint8_t VERSION = 1;
+
+	enum class Message : uint8_t {
+		State = 1,
+		Players = 2,
+		Map = 3
+	};
+
+	//step of quantized coordinates and speeds
+	constexpr double QUANTUM = 1. / 1024;
+
+	class BinaryWriter {
+	public:
+		explicit BinaryWriter(std::string& out) : out_(out) {
+		}
+
+		void Header(Message message) {
+			out_.push_back(static_cast<char>(VERSION));
+			out_.push_back(static_cast<char>(message));
+		}
+
+		void Byte(uint8_t value) {
+			out_.push_back(static_cast<char>(value));
+		}
+
+		void Varint(uint64_t value) {
+			while (value >= 0x80) {
+				out_.push_back(static_cast<char>(value | 0x80));
+				value >>= 7;
+			}
+			out_.push_back(static_cast<char>(value));
+		}
+
+		void Signed(int64_t value) {
+			Varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+		}
+
+		void Coordinate(double value) {
+			Signed(std::llround(value / QUANTUM));
+		}
+
+		void String(std::string_view str) {
+			Varint(str.size());
+			out_.append(str.data(), str.size());
+		}
+
+	private:
+		std::string& out_;
+	};
+
+	void WriteGameState(BinaryWriter& writer, const model::GameSession& session);
+
+	void WritePlayers(BinaryWriter& writer, const model::GameSession& session);
+
+	void WriteMap(BinaryWriter& writer, const model::Map& map, std::string_view loot_types_json);
+
+}   // namespace binary_writer
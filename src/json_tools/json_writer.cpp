@@ -0,0 +1,54 @@
+#include "json_writer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace json_writer {
+
+	size_t FormatDouble(double value, char* out) {
+		//std::to_chars gives the shortest round-trip digits as "2.5e-01"; boost::json writes them as "2.5E-1"
+		char buffer[MAX_DOUBLE_LENGTH];
+		auto end = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::scientific).ptr;
+		const char* exponent = std::find(buffer, end, 'e');
+		size_t length = exponent - buffer;
+		std::memcpy(out, buffer, length);
+		if (exponent == end)
+			return length;   //inf, nan
+		out[length++] = 'E';
+		const char* digits = exponent + 1;
+		if (*digits == '-')
+			out[length++] = *digits++;
+		else if (*digits == '+')
+			++digits;
+		while (digits + 1 < end && *digits == '0')
+			++digits;
+		while (digits < end)
+			out[length++] = *digits++;
+		return length;
+	}
+
+	std::string_view DirectionName(model::Direction direction) {
+		switch (direction) {
+		case model::Direction::NORTH:
+			return "U";
+		case model::Direction::SOUTH:
+			return "D";
+		case model::Direction::WEST:
+			return "L";
+		case model::Direction::EAST:
+			return "R";
+		}
+		return "";
+	}
+
+	size_t EstimateGameStateSize(const model::GameSession& session) {
+		constexpr size_t PER_DOG = 160;
+		constexpr size_t PER_BAG_ITEM = 32;
+		constexpr size_t PER_LOST_OBJECT = 80;
+		size_t size = 64;
+		for (auto& [name, dog] : session.GetDogs())
+			size += PER_DOG + PER_BAG_ITEM * dog->GetBag().size();
+		return size + PER_LOST_OBJECT * session.GetCurrentLostObjects().size();
+	}
+
+}   // namespace json_writer
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+#include "../model/model.h"
+
+namespace json_writer {
+
+	//longest output of FormatDouble
+	constexpr size_t MAX_DOUBLE_LENGTH = 32;
+
+	//shortest round-trip form in the notation of boost::json::serialize: 1E0, 2.5E-1, -0E0
+	size_t FormatDouble(double value, char* out);
+
+	//writes json text straight into "Buffer" (any string-like type with push_back and append) without a DOM.
+	//Keys are written as they are: they must not need escaping
+	template <typename Buffer>
+	class JsonWriter {
+	public:
+		explicit JsonWriter(Buffer& out) : out_(out) {
+		}
+
+		void BeginObject() {
+			Separate();
+			out_.push_back('{');
+			need_comma_ = false;
+		}
+
+		void EndObject() {
+			out_.push_back('}');
+			need_comma_ = true;
+		}
+
+		void BeginArray() {
+			Separate();
+			out_.push_back('[');
+			need_comma_ = false;
+		}
+
+		void EndArray() {
+			out_.push_back(']');
+			need_comma_ = true;
+		}
+
+		void Key(std::string_view key) {
+			Separate();
+			out_.push_back('"');
+			out_.append(key.data(), key.size());
+			out_.append("\":", 2);
+			need_comma_ = false;
+		}
+
+		void Key(uint64_t key) {
+			char buffer[24];
+			auto end = std::to_chars(buffer, buffer + sizeof(buffer), key).ptr;
+			Key(std::string_view(buffer, end - buffer));
+		}
+
+		void String(std::string_view str);
+
+		void Int(int64_t value) {
+			Separate();
+			char buffer[24];
+			auto end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+			out_.append(buffer, end - buffer);
+		}
+
+		void Uint(uint64_t value) {
+			Separate();
+			char buffer[24];
+			auto end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+			out_.append(buffer, end - buffer);
+		}
+
+		void Double(double value) {
+			Separate();
+			char buffer[MAX_DOUBLE_LENGTH];
+			out_.append(buffer, FormatDouble(value, buffer));
+		}
+
+		void Bool(bool value) {
+			Separate();
+			if (value)
+				out_.append("true", 4);
+			else
+				out_.append("false", 5);
+		}
+
+		void Null() {
+			Separate();
+			out_.append("null", 4);
+		}
+
+	private:
+		void Separate() {
+			if (need_comma_)
+				out_.push_back(',');
+			need_comma_ = true;
+		}
+
+		Buffer& out_;
+		bool need_comma_ = false;
+	};
+
+	template <typename Buffer>
+	void JsonWriter<Buffer>::String(std::string_view str) {
+		static constexpr char HEX[] = "0123456789abcdef";
+		Separate();
+		out_.push_back('"');
+		for (char c : str) {
+			switch (c) {
+			case '"': out_.append("\\\"", 2); break;
+			case '\\': out_.append("\\\\", 2); break;
+			case '\b': out_.append("\\b", 2); break;
+			case '\f': out_.append("\\f", 2); break;
+			case '\n': out_.append("\\n", 2); break;
+			case '\r': out_.append("\\r", 2); break;
+			case '\t': out_.append("\\t", 2); break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20) {
+					char escaped[] = { '\\', 'u', '0', '0', HEX[(c >> 4) & 0xf], HEX[c & 0xf] };
+					out_.append(escaped, sizeof(escaped));
+				}
+				else
+					out_.push_back(c);
+			}
+		}
+		out_.push_back('"');
+	}
+
+	std::string_view DirectionName(model::Direction direction);
+
+	template <typename Buffer>
+	void WriteDog(JsonWriter<Buffer>& writer, const model::Dog& dog) {
+		writer.BeginObject();
+		writer.Key("pos");
+		writer.BeginArray();
+		writer.Double(dog.GetPosition().x);
+		writer.Double(dog.GetPosition().y);
+		writer.EndArray();
+		writer.Key("speed");
+		writer.BeginArray();
+		writer.Double(dog.GetSpeed().s_x);
+		writer.Double(dog.GetSpeed().s_y);
+		writer.EndArray();
+		writer.Key("dir");
+		writer.String(DirectionName(dog.GetDirection()));
+		writer.Key("bag");
+		writer.BeginArray();
+		for (auto& [id, object] : dog.GetBag()) {
+			writer.BeginObject();
+			writer.Key("id");
+			writer.Uint(id);
+			writer.Key("type");
+			writer.Int(object.type);
+			writer.EndObject();
+		}
+		writer.EndArray();
+		writer.Key("score");
+		writer.Int(dog.GetScore());
+		writer.EndObject();
+	}
+
+	template <typename Buffer>
+	void WriteLostObject(JsonWriter<Buffer>& writer, const model::LostObject& object) {
+		writer.BeginObject();
+		writer.Key("type");
+		writer.Int(object.type);
+		writer.Key("pos");
+		writer.BeginArray();
+		writer.Double(object.position.x);
+		writer.Double(object.position.y);
+		writer.EndArray();
+		writer.EndObject();
+	}
+
+	//"players" and "lostObjects" members of the state
+	template <typename Buffer>
+	void WritePlayersAndLostObjects(JsonWriter<Buffer>& writer, const model::GameSession& session) {
+		writer.Key("players");
+		writer.BeginObject();
+		for (auto& [name, dog] : session.GetDogs()) {
+			writer.Key(dog->GetId());
+			WriteDog(writer, *dog);
+		}
+		writer.EndObject();
+		writer.Key("lostObjects");
+		if (session.GetCurrentLostObjects().empty()) {
+			writer.Null();
+			return;
+		}
+		writer.BeginObject();
+		for (auto& [id, object] : session.GetCurrentLostObjects()) {
+			writer.Key(id);
+			WriteLostObject(writer, object);
+		}
+		writer.EndObject();
+	}
+
+	//answer of /api/v1/game/state for "session":
+	//{"players":{"<id>":{"pos":[x,y],"speed":[x,y],"dir":"U","bag":[{"id":..,"type":..}],"score":..}},
+	// "lostObjects":{"<id>":{"type":..,"pos":[x,y]}}}, where "lostObjects" is null when there are none
+	template <typename Buffer>
+	void WriteGameState(JsonWriter<Buffer>& writer, const model::GameSession& session) {
+		writer.BeginObject();
+		WritePlayersAndLostObjects(writer, session);
+		writer.EndObject();
+	}
+
+	//answer of /api/v1/game/state?since=<tick>: what changed after tick "since" (see model::StateHistory)
+	//{"tick":..,"full":false,"players":{changed and new dogs},"removedPlayers":[ids],
+	// "lostObjects":{new lost objects},"removedLostObjects":[ids]}
+	//or, when the history does not reach back to "since", the whole state: {"tick":..,"full":true,"players":..,"lostObjects":..}
+	template <typename Buffer>
+	void WriteGameStateSince(JsonWriter<Buffer>& writer, const model::GameSession& session, uint64_t since) {
+		const auto& history = session.GetHistory();
+		writer.BeginObject();
+		writer.Key("tick");
+		writer.Uint(history.GetTick());
+		writer.Key("full");
+		writer.Bool(!history.CanDiff(since));
+		if (!history.CanDiff(since)) {
+			WritePlayersAndLostObjects(writer, session);
+			writer.EndObject();
+			return;
+		}
+		const auto write_removed = [&writer, since](const auto& removals) {
+			writer.BeginArray();
+			auto it = removals.end();
+			while (it != removals.begin() && std::prev(it)->tick > since)
+				--it;
+			for (; it != removals.end(); ++it)
+				writer.Uint(it->id);
+			writer.EndArray();
+			};
+		writer.Key("players");
+		writer.BeginObject();
+		for (auto& [name, dog] : session.GetDogs()) {
+			if (history.DogChangedAt(dog->GetId()) <= since)
+				continue;
+			writer.Key(dog->GetId());
+			WriteDog(writer, *dog);
+		}
+		writer.EndObject();
+		writer.Key("removedPlayers");
+		write_removed(history.GetRemovedDogs());
+		writer.Key("lostObjects");
+		writer.BeginObject();
+		for (auto& [id, object] : session.GetCurrentLostObjects()) {
+			if (history.LostObjectAddedAt(id) <= since)
+				continue;
+			writer.Key(id);
+			WriteLostObject(writer, object);
+		}
+		writer.EndObject();
+		writer.Key("removedLostObjects");
+		write_removed(history.GetRemovedLostObjects());
+		writer.EndObject();
+	}
+
+	//upper estimate of the state size, so that the buffer is allocated once
+	size_t EstimateGameStateSize(const model::GameSession& session);
+
+}   // namespace json_writer
@@ -0,0 +1,103 @@
+#include "state_cells.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "json_writer.h"
+
+namespace json_writer {
+
+	StateCells::StateCells(const model::GameSession& session) {
+		for (auto& [name, dog] : session.GetDogs()) {
+			auto& players = CellAt(dog->GetPosition()).players;
+			if (!players.empty())
+				players.push_back(',');
+			JsonWriter writer(players);
+			writer.Key(dog->GetId());
+			WriteDog(writer, *dog);
+		}
+		for (auto& [id, object] : session.GetCurrentLostObjects()) {
+			auto& lost_objects = CellAt(object.position).lost_objects;
+			if (!lost_objects.empty())
+				lost_objects.push_back(',');
+			JsonWriter writer(lost_objects);
+			writer.Key(id);
+			WriteLostObject(writer, object);
+		}
+	}
+
+	int32_t StateCells::CellOf(double coord) {
+		constexpr double LIMIT = std::numeric_limits<int32_t>::max();
+		return static_cast<int32_t>(std::clamp(std::floor(coord / CELL_SIZE), -LIMIT, LIMIT));
+	}
+
+	StateCells::Cell& StateCells::CellAt(model::Position position) {
+		int32_t x = CellOf(position.x);
+		int32_t y = CellOf(position.y);
+		if (cells_.empty()) {
+			min_x_ = max_x_ = x;
+			min_y_ = max_y_ = y;
+		}
+		min_x_ = std::min(min_x_, x);
+		max_x_ = std::max(max_x_, x);
+		min_y_ = std::min(min_y_, y);
+		max_y_ = std::max(max_y_, y);
+		return cells_[Key(x, y)];
+	}
+
+	void StateCells::Write(std::string& out, model::Position center, double radius) const {
+		int32_t from_x = std::max(CellOf(center.x - radius), min_x_);
+		int32_t to_x = std::min(CellOf(center.x + radius), max_x_);
+		int32_t from_y = std::max(CellOf(center.y - radius), min_y_);
+		int32_t to_y = std::min(CellOf(center.y + radius), max_y_);
+
+		//a window wider than the populated cells is cheaper to check cell by cell
+		const bool scan_cells = from_x <= to_x && from_y <= to_y
+			&& uint64_t(int64_t(to_x) - from_x + 1) * uint64_t(int64_t(to_y) - from_y + 1) > cells_.size();
+		const auto for_each_cell = [&](auto&& fn) {
+			if (scan_cells) {
+				for (auto& [key, cell] : cells_) {
+					auto x = int32_t(uint32_t(key >> 32));
+					auto y = int32_t(uint32_t(key));
+					if (x >= from_x && x <= to_x && y >= from_y && y <= to_y)
+						fn(cell);
+				}
+				return;
+			}
+			for (int64_t x = from_x; x <= to_x; ++x)
+				for (int64_t y = from_y; y <= to_y; ++y)
+					if (auto it = cells_.find(Key(int32_t(x), int32_t(y))); it != cells_.end())
+						fn(it->second);
+			};
+		const auto append = [&out](const std::string& fragment, bool& first) {
+			if (fragment.empty())
+				return;
+			if (!first)
+				out.push_back(',');
+			out.append(fragment);
+			first = false;
+			};
+
+		out.append("{\"players\":{");
+		bool first = true;
+		for_each_cell([&](const Cell& cell) {
+			append(cell.players, first);
+			});
+		out.append("},\"lostObjects\":");
+		size_t objects_at = out.size();
+		out.push_back('{');
+		first = true;
+		for_each_cell([&](const Cell& cell) {
+			append(cell.lost_objects, first);
+			});
+		if (first) {
+			out.resize(objects_at);
+			out.append("null");   //as WriteGameState does for no lost objects
+		}
+		else
+			out.push_back('}');
+		out.push_back('}');
+	}
+
+}   // namespace json_writer
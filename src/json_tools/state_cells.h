@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "../model/model.h"
+
+namespace json_writer {
+
+	//state of a session split into square cells of CELL_SIZE, each with its dogs and lost objects already
+	//encoded: an area-of-interest answer is put together from whole cells without encoding anything again
+	class StateCells {
+	public:
+		static constexpr double CELL_SIZE = 16.;
+
+		explicit StateCells(const model::GameSession& session);
+
+		//answer of /api/v1/game/state?radius=<r>: the dogs and lost objects of the cells that intersect the
+		//square with half side "radius" around "center", in the format of WriteGameState
+		void Write(std::string& out, model::Position center, double radius) const;
+
+	private:
+		struct Cell {
+			std::string players;        //"<id>":{..},"<id>":{..}
+			std::string lost_objects;
+		};
+
+		static int32_t CellOf(double coord);
+
+		static uint64_t Key(int32_t x, int32_t y) {
+			return (uint64_t(uint32_t(x)) << 32) | uint32_t(y);
+		}
+
+		Cell& CellAt(model::Position position);
+
+		std::unordered_map<uint64_t, Cell> cells_;
+		//cells out of these bounds are empty
+		int32_t min_x_ = 0;
+		int32_t max_x_ = -1;
+		int32_t min_y_ = 0;
+		int32_t max_y_ = -1;
+	};
+
+}   // namespace json_writer
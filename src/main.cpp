@@ -1,7 +1,9 @@
 //#include "sdk.h"
 #include <iostream>
 #include <thread>
+#include <algorithm>
 #include <memory>
+#include <random>
 #include <cstdlib>
 #include <stdexcept>
 
@@ -10,12 +12,14 @@
 #include <boost/asio/signal_set.hpp>
 #include <boost/asio/strand.hpp>
 #include <boost/asio/io_context.hpp>
+#include <boost/asio/executor_work_guard.hpp>
 
 #include "json_tools/json_loader.h"
 #include "web/request_handler.h"
 #include "web/http_server.h"
 #include "web/log.h"
 #include "web/timer.h"
+#include "web/cpu_affinity.h"
 #include "extra/extra_data.h"
 #include "database_tools/postgres.h"
 
@@ -26,15 +30,67 @@ namespace po = boost::program_options;
 
 namespace {
 
+ // worker "index" gets one cpu of "io_cpus" (round robin); without "io_cpus" it may run on any cpu allowed at
+ // startup, so that it does not inherit the affinity of the pinned simulation thread
+    cpu_affinity::CpuSet WorkerCpus(size_t index, const cpu_affinity::CpuSet& io_cpus, const cpu_affinity::CpuSet& all_cpus) {
+        if (io_cpus.empty())
+            return all_cpus;
+        return { io_cpus[index % io_cpus.size()] };
+    }
+
+    boost::json::value DescribePlacement(const cpu_affinity::CpuSet& cpus, bool pinned = true) {
+        return {
+            {"cpus", cpus},
+            {"nodes", cpu_affinity::NodesOf(cpus)},
+            {"pinned", pinned}
+        };
+    }
+
+ // placement of a worker pinned to "cpus" (or not, if "pinned" is false); a failure is logged, the worker
+ // then runs wherever the os puts it
+    boost::json::value WorkerPlacement(const cpu_affinity::CpuSet& cpus, bool pinned) {
+        if (!pinned)
+            ServerErrorLog(0, "failed to pin an io thread, it is not restricted to its cpus", "thread placement");
+        return DescribePlacement(cpus, pinned);
+    }
+
+ // pins the workers and returns their placement for the startup report
+    boost::json::array PlaceWorkers(std::vector<std::jthread>& workers, const cpu_affinity::CpuSet& io_cpus, const cpu_affinity::CpuSet& all_cpus) {
+        boost::json::array placement;
+        for (size_t i = 0; i < workers.size(); ++i) {
+            auto cpus = WorkerCpus(i, io_cpus, all_cpus);
+            placement.push_back(WorkerPlacement(cpus, cpu_affinity::PinThread(workers[i].native_handle(), cpus)));
+        }
+        return placement;
+    }
+
+    void ReportPlacement(boost::json::array io_placement, const cpu_affinity::CpuSet& sim_cpus) {
+        std::vector<int> all_nodes;
+        for (auto& [cpu, node] : cpu_affinity::CpuToNode())
+            all_nodes.push_back(node);
+        std::sort(all_nodes.begin(), all_nodes.end());
+        all_nodes.erase(std::unique(all_nodes.begin(), all_nodes.end()), all_nodes.end());
+        boost::json::value simulation = sim_cpus.empty() ? boost::json::value("shared with io") : DescribePlacement(sim_cpus);
+        ThreadPlacementLog({
+            {"numaNodes", all_nodes.size()},
+            {"simulation", simulation},
+            {"io", io_placement}
+        });
+    }
+
  // starting fn func on n threads
     template <typename Fn>
-    void RunWorkers(unsigned num_of_threads, const Fn& fn) {
+    void RunWorkers(unsigned num_of_threads, const cpu_affinity::CpuSet& io_cpus, const cpu_affinity::CpuSet& all_cpus, const Fn& fn) {
         num_of_threads = std::max(1u, num_of_threads);
         std::vector<std::jthread> workers;
         workers.reserve(num_of_threads - 1);       
         while (--num_of_threads) {
             workers.emplace_back(fn);
         }
+        auto placement = PlaceWorkers(workers, io_cpus, all_cpus);
+        auto cpus = WorkerCpus(workers.size(), io_cpus, all_cpus);
+        placement.push_back(WorkerPlacement(cpus, cpu_affinity::PinCurrentThread(cpus)));
+        ReportPlacement(std::move(placement), {});
         fn();
     }
 
@@ -46,8 +102,36 @@ namespace {
         std::string log_file_path;
         std::string save_state_period;
         std::string random_spawn;
+        std::string record_file_path;
+        std::string random_seed;
+        std::string reactors;
+        std::string io_cpus;
+        std::string sim_cpus;
+        std::string compression_level;
+        std::string static_cache_control;
+        std::vector<std::string> rate_limits;
+        std::vector<std::string> ip_rate_limits;
     };
 
+    //"<endpoint>=<rate>/<burst>" options of the command line
+    void SetRateLimits(http_handler::RequestHandler& handler, const std::vector<std::string>& options, bool per_address) {
+        for (const auto& option : options) {
+            auto limit = http_handler::ParseRateLimit(option);
+            if (!limit)
+                throw std::runtime_error("Rate limit must be <endpoint>=<rate>/<burst>, got " + option);
+            handler.SetRateLimit(limit->first, limit->second, per_address);
+        }
+    }
+
+    void WaitReloadSignal(net::signal_set& signals, http_handler::RequestHandler& handler) {
+        signals.async_wait([&signals, &handler](const sys::error_code& ec, [[maybe_unused]] int signal_number) {
+            if (ec)
+                return;
+            handler.ReloadStaticFiles();
+            WaitReloadSignal(signals, handler);
+        });
+    }
+
     std::optional<Args> ParseCommandLine(int argc, const char* const argv[]) {
         po::options_description desc{ "All options"s };
         Args args;
@@ -59,7 +143,16 @@ namespace {
             ("state-file", po::value(&args.state_file_path)->value_name("state"s), "Set state file path")
             ("log-file", po::value(&args.log_file_path)->value_name("log"s), "Set log file path")
             ("save-state-period", po::value(&args.save_state_period)->value_name("state-period"s),"Set period of auto save state")
-            ("randomize-spawn-points", "Set random-spawn configuration");
+            ("randomize-spawn-points", "Set random-spawn configuration")
+            ("record-file", po::value(&args.record_file_path)->value_name("record"s), "Record every game input to file for replay")
+            ("random-seed", po::value(&args.random_seed)->value_name("seed"s), "Set seed of the game random generator")
+            ("reactors", po::value(&args.reactors)->value_name("count"s), "Serve connections by independent single-threaded io_contexts (0 - one per core)")
+            ("io-cpus", po::value(&args.io_cpus)->value_name("cpu-list"s), "Pin io threads to cpus, one cpu per thread (e.g. 0-3,8)")
+            ("sim-cpus", po::value(&args.sim_cpus)->value_name("cpu-list"s), "Run the game simulation on its own thread pinned to cpus")
+            ("compression-level", po::value(&args.compression_level)->value_name("0-9"s), "Set gzip/deflate level of responses (0 - no compression)")
+            ("static-cache-control", po::value(&args.static_cache_control)->value_name("value"s), "Set Cache-Control of static files (default: no-cache)")
+            ("rate-limit", po::value(&args.rate_limits)->composing()->value_name("endpoint=rate/burst"s), "Limit requests per token to a game endpoint (e.g. action=20/40)")
+            ("ip-rate-limit", po::value(&args.ip_rate_limits)->composing()->value_name("endpoint=rate/burst"s), "Limit requests per remote address to a game endpoint");
 
         po::variables_map vm;
         po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -167,6 +260,14 @@ int main(int argc, const char* argv[]) {
         SetSaveParams(args, state_file_path, is_save, is_auto_save, save_interval);
        
 
+        // 0. thread placement: the main thread becomes the simulation thread, so it is pinned before the game
+        // is loaded; with the default first-touch policy the game state then lives on the node of "sim_cpus"
+        const auto all_cpus = cpu_affinity::AllowedCpus();
+        const auto io_cpus = cpu_affinity::ParseCpuList(args->io_cpus);
+        const auto sim_cpus = cpu_affinity::ParseCpuList(args->sim_cpus);
+        if (!sim_cpus.empty() && !cpu_affinity::PinCurrentThread(sim_cpus))
+            throw std::runtime_error("Failed to pin the simulation thread");
+
         postgres_tools::PostgresDatabase database(GetDatabaseUrl());
 
         // 1. maps from file and setting random player position
@@ -174,40 +275,82 @@ int main(int argc, const char* argv[]) {
         if (args->random_spawn == "random") {
             game.SetRandomSpawn();
         }
+        const uint64_t random_seed = args->random_seed.empty() ? std::random_device{}() : std::stoull(args->random_seed);
+        model::SetRandomSeed(random_seed);
 
         extra_data::Json_data lost_objects_json_data = json_loader::LoadExtraData(config_file_path);
 
         // 2. io_context & strand
+        // in multi-reactor mode every reactor has its own io_context, acceptor (SO_REUSEPORT) and thread, so
+        // connections stay on one core; then, as with "sim_cpus", the game strand gets its own io_context and thread
         const unsigned num_threads = std::thread::hardware_concurrency();
+        unsigned num_reactors = 0;
+        if (!args->reactors.empty()) {
+            num_reactors = static_cast<unsigned>(std::stoul(args->reactors));
+            if (num_reactors == 0)
+                num_reactors = std::max(1u, num_threads);
+        }
+        const bool dedicated_game_thread = num_reactors > 0 || !sim_cpus.empty();
         net::io_context ioc(num_threads);
-        net::strand strand = net::make_strand(ioc);
+        net::io_context game_ioc(1);
+        net::io_context& game_context = dedicated_game_thread ? game_ioc : ioc;
+        net::strand strand = net::make_strand(game_context);
+        std::vector<std::unique_ptr<net::io_context>> reactors;
+        for (unsigned i = 0; i < num_reactors; ++i) {
+            reactors.push_back(std::make_unique<net::io_context>(1));
+        }
 
  
         // 3. http_handler + logging decorator
         http_handler::RequestHandler handler {game, lost_objects_json_data, strand, database };
         handler.SetFilePath(static_dir_path);
         handler.SetSerializationParams(is_save, is_auto_save, save_interval, state_file_path);
+        if (!args->compression_level.empty()) {
+            int level = std::stoi(args->compression_level);
+            if (level < 0 || level > 9)
+                throw std::runtime_error("Compression level must be from 0 to 9");
+            handler.SetCompressionLevel(level);
+        }
+        if (!args->static_cache_control.empty()) {
+            handler.SetStaticCacheControl(args->static_cache_control);
+        }
+        SetRateLimits(handler, args->rate_limits, false);
+        SetRateLimits(handler, args->ip_rate_limits, true);
         if (std::filesystem::exists(state_file_path)) {
             handler.Deserialize();
         }
+        if (!args->record_file_path.empty()) {
+            handler.StartRecording(std::filesystem::weakly_canonical(args->record_file_path), random_seed);
+        }
         http_handler::LoggingRequestHandler logging_handler(handler);
       
 
         // 4.SIGINT & SIGTERM
-        net::signal_set signals(ioc, SIGINT, SIGTERM);
-        signals.async_wait([&ioc, &handler, is_save](const sys::error_code& ec, [[maybe_unused]] int signal_number) {
+        net::signal_set signals(game_context, SIGINT, SIGTERM);
+        signals.async_wait([&ioc, &game_ioc, &reactors, &handler, is_save](const sys::error_code& ec, [[maybe_unused]] int signal_number) {
            if (!ec) {
                 ioc.stop();
+                game_ioc.stop();
+                for (auto& reactor : reactors)
+                    reactor->stop();
                 if (is_save)
                    handler.Serialize();
             }
         });
+        // SIGHUP rereads the static files; it is handled on an io context so the game strand is not held up
+        net::signal_set reload_signals(reactors.empty() ? ioc : *reactors.front(), SIGHUP);
+        WaitReloadSignal(reload_signals, handler);
+
         // 5. starting http_handler
         const auto address = net::ip::make_address("0.0.0.0");
         constexpr net::ip::port_type port = 8080;
-        http_server::ServeHttp(ioc, { address, port }, [&logging_handler](auto&& req, auto&& send) {
-            logging_handler(std::forward<decltype(req)>(req), std::forward<decltype(send)>(send));
-        });
+        const auto serve_request = http_server::HandlerRef(logging_handler);
+        if (reactors.empty()) {
+            http_server::ServeHttp(ioc, { address, port }, serve_request);
+        }
+        for (auto& reactor : reactors) {
+            http_server::ServeHttp(*reactor, { address, port }, serve_request, true);
+        }
         
         // 6. timer autoupdate
         std::shared_ptr<Timer::Ticker> ticker;
@@ -220,16 +363,48 @@ int main(int argc, const char* argv[]) {
               ticker->Start();
         }
 
+        // full rate limit buckets are forgotten off the game strand
+        std::shared_ptr<Timer::Ticker> rate_limit_sweeper;
+        if (handler.HasRateLimits()) {
+            rate_limit_sweeper = std::make_shared<Timer::Ticker>(net::make_strand(reactors.empty() ? ioc : *reactors.front()), 10s,
+                [&handler](std::chrono::milliseconds) {
+                    handler.SweepRateLimits();
+                });
+            rate_limit_sweeper->Start();
+        }
+
 
       //   std::cout << "Server has started..."sv << std::endl;
         ServerStartLog(port, address);
 
         // 7. handling async operation
-        RunWorkers(std::max(1u, num_threads), [&ioc] {
-            ioc.run();
-        });
+        if (!dedicated_game_thread) {
+            RunWorkers(std::max(1u, num_threads), io_cpus, all_cpus, [&ioc] {
+                ioc.run();
+            });
+        }
+        else {
+            // without auto tick the game strand may have nothing to do for a while
+            auto game_work = net::make_work_guard(game_ioc);
+            std::vector<std::jthread> io_threads;
+            if (reactors.empty()) {
+                for (unsigned i = 0; i < std::max(1u, num_threads); ++i) {
+                    io_threads.emplace_back([&ioc] {
+                        ioc.run();
+                    });
+                }
+            }
+            for (auto& reactor : reactors) {
+                io_threads.emplace_back([&reactor] {
+                    reactor->run();
+                });
+            }
+            ReportPlacement(PlaceWorkers(io_threads, io_cpus, all_cpus), sim_cpus.empty() ? all_cpus : sim_cpus);
+            game_ioc.run();
+        }
 
             handler.Serialize();
+        handler.StopRecording();
 
         ServerStopLog(0);
     } catch (const std::exception& ex) {
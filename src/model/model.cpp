@@ -1,10 +1,16 @@
 #include "model.h"
 
+#include <random>
 #include <stdexcept>
 
 namespace model {
 using namespace std::literals;
 
+namespace {
+    //the only source of randomness of the simulation; seeded once at startup so that a recorded run can be replayed
+    std::mt19937 random_engine{ std::random_device{}() };
+}
+
 void Map::AddOffice(const Office& office) {
     if (warehouse_id_to_index_.contains(office.GetId())) {
         throw std::invalid_argument("Duplicate warehouse");
@@ -25,7 +31,6 @@ void GameSession::RegainDog(std::shared_ptr<Dog> dog) {
 }
 
 void GameSession::AddDog(std::shared_ptr<Dog> dog) {
-    srand(time(0));
     Position pos;
     if (!is_rand_spawn_) {
         pos = { static_cast<double>(map_.GetRoads().begin()->GetStart().x),static_cast<double>(map_.GetRoads().begin()->GetStart().y) };
@@ -56,7 +61,6 @@ void GameSession::AddDog(std::shared_ptr<Dog> dog) {
 
 void GameSession::GenerateLoot(std::chrono::milliseconds time_delta) {
     unsigned need_to_gen = loot_generator_.Generate(time_delta, GetCurrentLostObjects().size(), dogs_.size());
-    srand(time(NULL));
     for (unsigned i = 0; i < need_to_gen; ++i) {
         int type = random_int() % map_.GetMaxCountOfLootObjects();
         int value = map_.GetPriceList().find(type)->second;
@@ -249,7 +253,11 @@ void tag_invoke(boost::json::value_from_tag, boost::json::value& jv, const std::
 }
 
 int random_int() {
-    return rand();
+    return static_cast<int>(random_engine() >> 1);
+}
+
+void SetRandomSeed(uint64_t seed) {
+    random_engine.seed(static_cast<std::mt19937::result_type>(seed));
 }
 
 }  // namespace model
@@ -2,7 +2,9 @@
 #include <string>
 #include <unordered_map>
 #include <vector>
+#include <array>
 #include <atomic>
+#include <memory>
 
 #include <boost/json.hpp>
 #include <boost/archive/text_oarchive.hpp>
@@ -14,6 +16,7 @@
 #include "loot_generator.h"
 #include "../extra/tagged.h"
 #include "collision_detector.h"
+#include "state_history.h"
 
 namespace model {
 
@@ -453,6 +456,13 @@ namespace model {
     };
 
     //contains map and all dogs on it
+    //encodings of the published state of a session
+    enum class StateEncoding {
+        Json,
+        Binary,
+        Count
+    };
+
     class GameSession {
     public:
         GameSession(const Map& map, bool is_rand_spawn, LootGeneratorParams loot_generator_params) :
@@ -503,6 +513,30 @@ namespace model {
 
         void LeaveItems(double time_delta);
 
+        //encoded state published by the game strand for readers on any thread; nullptr after a change that
+        //the last snapshot does not show
+        std::shared_ptr<const std::string> GetStateSnapshot(StateEncoding encoding = StateEncoding::Json) const {
+            return state_snapshots_[static_cast<size_t>(encoding)].load(std::memory_order_acquire);
+        }
+
+        void PublishStateSnapshot(std::shared_ptr<const std::string> snapshot, StateEncoding encoding = StateEncoding::Json) {
+            state_snapshots_[static_cast<size_t>(encoding)].store(std::move(snapshot), std::memory_order_release);
+        }
+
+        void InvalidateStateSnapshot() {
+            for (auto& snapshot : state_snapshots_)
+                snapshot.store(nullptr, std::memory_order_release);
+        }
+
+        const StateHistory& GetHistory() const {
+            return history_;
+        }
+
+        //closes the tick in the history of changes
+        void RecordHistory() {
+            history_.Record(*this);
+        }
+
         void DeleteDogs(const std::vector<Dog::Id>& list_of_id) {
             for (auto& p : list_of_id) {
                 for (auto m = dogs_.begin(); m != dogs_.end(); ++m) {
@@ -524,6 +558,9 @@ namespace model {
         loot_gen::LootGenerator loot_generator_;
         bool is_rand_spawn_ = false;
 
+        std::array<std::atomic<std::shared_ptr<const std::string>>, static_cast<size_t>(StateEncoding::Count)> state_snapshots_;
+        StateHistory history_;
+
         static inline std::atomic_int lost_object_id_ = 0;
     };
 
@@ -554,6 +591,14 @@ namespace model {
             return  game_sessions_.emplace_back(std::make_shared<GameSession>(*FindMap(id), is_rand_game_spawn_, loot_generator_params_));
         }
 
+        //unlike FindGameSession does not start a session; nullptr if the map has none yet
+        std::shared_ptr<GameSession> FindRunningGameSession(const Map::Id& id) const {
+            for (auto& p : game_sessions_)
+                if (p->GetMapId() == id)
+                    return p;
+            return nullptr;
+        }
+
         void SetRandomSpawn() {
             is_rand_game_spawn_ = true;
         }
@@ -604,4 +649,7 @@ namespace model {
 
     int random_int();
 
+    //restarts the random sequence used for spawn points and loot; the same seed gives the same game
+    void SetRandomSeed(uint64_t seed);
+
 }  // namespace model
@@ -0,0 +1,83 @@
+#include "state_history.h"
+
+#include "model.h"
+
+namespace model {
+
+    namespace {
+        //stores the fields of "dog" in "fields"; true if any of them differs from what was there
+        template <typename Fields>
+        bool UpdateDogFields(Fields& fields, const Dog& dog) {
+            const auto position = dog.GetPosition();
+            const auto speed = dog.GetSpeed();
+            const int direction = static_cast<int>(dog.GetDirection());
+            const auto& bag = dog.GetBag();
+            bool changed = fields.x != position.x || fields.y != position.y || fields.speed_x != speed.s_x || fields.speed_y != speed.s_y
+                || fields.direction != direction || fields.score != dog.GetScore() || fields.bag.size() != bag.size();
+            if (!changed) {
+                auto stored = fields.bag.begin();
+                for (auto& [id, object] : bag) {
+                    if (stored->first != id || stored->second != object.type) {
+                        changed = true;
+                        break;
+                    }
+                    ++stored;
+                }
+            }
+            if (!changed)
+                return false;
+            fields.x = position.x;
+            fields.y = position.y;
+            fields.speed_x = speed.s_x;
+            fields.speed_y = speed.s_y;
+            fields.direction = direction;
+            fields.score = dog.GetScore();
+            fields.bag.clear();
+            for (auto& [id, object] : bag)
+                fields.bag.emplace_back(id, object.type);
+            return true;
+        }
+    }
+
+    void StateHistory::Record(const GameSession& session) {
+        ++tick_;
+
+        for (auto& [name, dog] : session.GetDogs()) {
+            auto [it, inserted] = dogs_.try_emplace(dog->GetId(), DogVersion{ {}, tick_, tick_ });
+            if (UpdateDogFields(it->second.fields, *dog) && !inserted)
+                it->second.changed_at = tick_;
+            it->second.seen_at = tick_;
+        }
+        gone_.clear();
+        for (auto& [id, version] : dogs_)
+            if (version.seen_at != tick_)
+                gone_.push_back(id);
+        for (auto id : gone_) {
+            dogs_.erase(id);
+            removed_dogs_.push_back({ tick_, id });
+        }
+
+        const auto& lost_objects = session.GetCurrentLostObjects();
+        for (auto& [id, object] : lost_objects)
+            lost_objects_.try_emplace(id, tick_);
+        if (lost_objects_.size() != lost_objects.size()) {
+            gone_.clear();
+            for (auto& [id, added_at] : lost_objects_)
+                if (!lost_objects.contains(id))
+                    gone_.push_back(id);
+            for (auto id : gone_) {
+                lost_objects_.erase(id);
+                removed_lost_objects_.push_back({ tick_, id });
+            }
+        }
+
+        Forget(removed_dogs_);
+        Forget(removed_lost_objects_);
+    }
+
+    void StateHistory::Forget(std::deque<Removal>& removals) {
+        while (!removals.empty() && tick_ - removals.front().tick >= WINDOW)
+            removals.pop_front();
+    }
+
+}  // namespace model
@@ -0,0 +1,90 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace model {
+
+    class GameSession;
+
+    //per-tick versions of a game session: the tick at which every dog last changed and every lost object
+    //appeared, and the dogs and lost objects removed during the last WINDOW ticks. Answers "what changed
+    //since tick T" for the delta state; used on the game strand only
+    class StateHistory {
+    public:
+        static constexpr uint64_t WINDOW = 600;
+
+        //unknown entries appeared after the last recorded tick
+        static constexpr uint64_t NOT_RECORDED = std::numeric_limits<uint64_t>::max();
+
+        struct Removal {
+            uint64_t tick;
+            uint64_t id;
+        };
+
+        //number of recorded ticks
+        uint64_t GetTick() const {
+            return tick_;
+        }
+
+        //advances the tick and compares the session with the previous tick
+        void Record(const GameSession& session);
+
+        //true if the changes since "since" are still known; a client without state asks for tick 0
+        bool CanDiff(uint64_t since) const {
+            return since > 0 && since <= tick_ && tick_ - since < WINDOW;
+        }
+
+        uint64_t DogChangedAt(uint64_t dog_id) const {
+            auto it = dogs_.find(dog_id);
+            return it == dogs_.end() ? NOT_RECORDED : it->second.changed_at;
+        }
+
+        uint64_t LostObjectAddedAt(uint64_t lost_object_id) const {
+            auto it = lost_objects_.find(lost_object_id);
+            return it == lost_objects_.end() ? NOT_RECORDED : it->second;
+        }
+
+        //removals in the order of ticks
+        const std::deque<Removal>& GetRemovedDogs() const {
+            return removed_dogs_;
+        }
+
+        const std::deque<Removal>& GetRemovedLostObjects() const {
+            return removed_lost_objects_;
+        }
+
+    private:
+        //everything of a dog that the state answer shows, as of the tick it was last seen; compared field by
+        //field, so no change can be missed
+        struct DogFields {
+            double x = 0.;
+            double y = 0.;
+            double speed_x = 0.;
+            double speed_y = 0.;
+            int direction = 0;
+            int score = 0;
+            std::vector<std::pair<std::size_t, int>> bag;   //id and type of every object
+        };
+
+        struct DogVersion {
+            DogFields fields;
+            uint64_t changed_at;
+            uint64_t seen_at;
+        };
+
+        void Forget(std::deque<Removal>& removals);
+
+        uint64_t tick_ = 0;
+        std::unordered_map<uint64_t, DogVersion> dogs_;
+        std::unordered_map<uint64_t, uint64_t> lost_objects_;
+        std::deque<Removal> removed_dogs_;
+        std::deque<Removal> removed_lost_objects_;
+        std::vector<uint64_t> gone_;
+    };
+
+}  // namespace model
@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include <boost/program_options.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/json.hpp>
+
+#include "../json_tools/json_loader.h"
+#include "../app/app.h"
+#include "../app/action_recorder.h"
+#include "../serialization/app_serialization.h"
+
+using namespace std::literals;
+namespace net = boost::asio;
+namespace po = boost::program_options;
+
+namespace {
+
+    struct Args {
+        std::string config_file_path;
+        std::string record_file_path;
+        std::string state_file_path;
+        std::string timings_file_path;
+        bool random_spawn = false;
+    };
+
+    std::optional<Args> ParseCommandLine(int argc, const char* const argv[]) {
+        po::options_description desc{ "All options"s };
+        Args args;
+        desc.add_options()
+            ("help,h", "Show help")
+            ("config-file,c", po::value(&args.config_file_path)->value_name("file"s), "Set config file path")
+            ("record-file,r", po::value(&args.record_file_path)->value_name("record"s), "Set record file path")
+            ("state-file", po::value(&args.state_file_path)->value_name("state"s), "Set state file the recorded server started from")
+            ("timings-file", po::value(&args.timings_file_path)->value_name("csv"s), "Write time of every tick to file")
+            ("randomize-spawn-points", "Set random-spawn configuration");
+
+        po::variables_map vm;
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+
+        if (vm.contains("help"s)) {
+            std::cout << desc;
+            return std::nullopt;
+        }
+        if (!vm.contains("config-file"s)) {
+            throw std::runtime_error("Config file path is not specified"s);
+        }
+        if (!vm.contains("record-file"s)) {
+            throw std::runtime_error("Record file path is not specified"s);
+        }
+        args.random_spawn = vm.contains("randomize-spawn-points"s);
+        return args;
+    }
+
+    double Percentile(const std::vector<double>& sorted_values, double p) {
+        if (sorted_values.empty())
+            return 0.;
+        size_t index = static_cast<size_t>(p * (sorted_values.size() - 1));
+        return sorted_values[index];
+    }
+
+}  // namespace
+
+//feeds a recorded game through GameTimer::Tick at full speed and reports the time of every tick; records of
+//retired dogs are not saved anywhere
+int main(int argc, const char* argv[]) {
+    try {
+        auto args = ParseCommandLine(argc, argv);
+        if (!args) {
+            return EXIT_SUCCESS;
+        }
+
+        model::Game game = json_loader::LoadGame(std::filesystem::weakly_canonical(args->config_file_path));
+        if (args->random_spawn) {
+            game.SetRandomSpawn();
+        }
+
+        net::io_context ioc(1);
+        net::strand strand = net::make_strand(ioc);
+
+        app::Players players;
+        app::PlayerTokens tokens;
+        app::ActionRecorder no_recorder;
+        app_serialization::SerializingListener listener(players, game, tokens);
+        if (!args->state_file_path.empty()) {
+            listener.SetParams(false, false, 0., std::filesystem::weakly_canonical(args->state_file_path));
+            listener.Deserialize();
+        }
+        app::GameTimer game_timer(players, tokens, game.GetGameSessions(), strand, listener, nullptr, no_recorder);
+
+        app::ActionReader reader(std::filesystem::weakly_canonical(args->record_file_path));
+        std::vector<double> tick_times_ms;
+        size_t joins = 0, actions = 0;
+        std::optional<uint64_t> recorded_digest;
+
+        while (auto event = reader.Next()) {
+            if (auto seed = std::get_if<app::record::Seed>(&*event)) {
+                model::SetRandomSeed(seed->seed);
+            }
+            else if (auto join = std::get_if<app::record::Join>(&*event)) {
+                app::JoinGame(game, players, tokens, join->user_name, model::Map::Id(join->map_id), join->token);
+                ++joins;
+            }
+            else if (auto action = std::get_if<app::record::Action>(&*event)) {
+                auto player = tokens.FindPlayerByToken(action->token);
+                if (!player || !player->Move(action->direction))
+                    throw std::runtime_error("Replay diverged: action of unknown player");
+                ++actions;
+            }
+            else if (auto tick = std::get_if<app::record::Tick>(&*event)) {
+                auto start = std::chrono::steady_clock::now();
+                game_timer.Tick(tick->time_delta);
+                ioc.restart();
+                ioc.run();
+                auto finish = std::chrono::steady_clock::now();
+                tick_times_ms.push_back(std::chrono::duration<double, std::milli>(finish - start).count());
+            }
+            else if (auto retirement = std::get_if<app::record::Retirement>(&*event)) {
+                if (retirement->dog_ids != game_timer.GetLastRetired())
+                    throw std::runtime_error("Replay diverged: different dogs retired at tick "s + std::to_string(tick_times_ms.size()));
+            }
+            else if (auto digest = std::get_if<app::record::Digest>(&*event)) {
+                recorded_digest = digest->digest;
+            }
+        }
+
+        const uint64_t digest = app::StateDigest(game);
+        if (recorded_digest && *recorded_digest != digest)
+            throw std::runtime_error("Replay diverged: final state differs from the recorded one");
+
+        if (!args->timings_file_path.empty()) {
+            std::ofstream timings(args->timings_file_path);
+            timings << "tick,time_ms\n";
+            for (size_t i = 0; i < tick_times_ms.size(); ++i)
+                timings << i << ',' << tick_times_ms[i] << '\n';
+        }
+
+        std::vector<double> sorted = tick_times_ms;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.;
+        for (double t : sorted)
+            total += t;
+        boost::json::value report = {
+            {"joins", joins},
+            {"actions", actions},
+            {"ticks", tick_times_ms.size()},
+            {"total_ms", total},
+            {"mean_ms", sorted.empty() ? 0. : total / sorted.size()},
+            {"p50_ms", Percentile(sorted, 0.5)},
+            {"p99_ms", Percentile(sorted, 0.99)},
+            {"max_ms", sorted.empty() ? 0. : sorted.back()},
+            {"digest", digest},
+            {"digest_verified", recorded_digest.has_value()}
+        };
+        std::cout << boost::json::serialize(report) << std::endl;
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace http_server {
+
+    SessionArena::SessionArena(size_t block_size) : block_size_(block_size) {
+    }
+
+    boost::json::storage_ptr SessionArena::JsonStorage(std::pmr::memory_resource* resource) {
+        if (auto arena = dynamic_cast<SessionArena*>(resource))
+            return arena->JsonStorage();
+        return {};
+    }
+
+    void* SessionArena::do_allocate(size_t bytes, size_t alignment) {
+        std::lock_guard lock(mutex_);
+        if (live_allocations_ == 0)
+            Rewind();
+        while (true) {
+            if (current_block_ < blocks_.size()) {
+                auto& block = blocks_[current_block_];
+                auto base = reinterpret_cast<uintptr_t>(block.data.get());
+                size_t start = ((base + offset_ + alignment - 1) & ~(alignment - 1)) - base;
+                if (start + bytes <= block.size) {
+                    offset_ = start + bytes;
+                    ++live_allocations_;
+                    return block.data.get() + start;
+                }
+                if (current_block_ + 1 < blocks_.size()) {
+                    ++current_block_;
+                    offset_ = 0;
+                    continue;
+                }
+            }
+            size_t size = std::max(block_size_ << std::min<size_t>(blocks_.size(), 4), bytes + alignment);
+            blocks_.push_back({ std::make_unique_for_overwrite<std::byte[]>(size), size });
+            current_block_ = blocks_.size() - 1;
+            offset_ = 0;
+        }
+    }
+
+    void SessionArena::do_deallocate([[maybe_unused]] void* p, [[maybe_unused]] size_t bytes, [[maybe_unused]] size_t alignment) {
+        bool is_last = false;
+        {
+            std::lock_guard lock(mutex_);
+            is_last = --live_allocations_ == 0 && released_;
+        }
+        if (is_last)
+            delete this;
+    }
+
+    void SessionArena::Release() {
+        bool is_unused = false;
+        {
+            std::lock_guard lock(mutex_);
+            released_ = true;
+            is_unused = live_allocations_ == 0;
+        }
+        if (is_unused)
+            delete this;
+    }
+
+    bool SessionArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+        return this == &other;
+    }
+
+    void SessionArena::Rewind() {
+        size_t retained = 0;
+        size_t kept = 0;
+        while (kept < blocks_.size() && retained + blocks_[kept].size <= MAX_RETAINED)
+            retained += blocks_[kept++].size;
+        blocks_.resize(std::max<size_t>(kept, blocks_.empty() ? 0 : 1));
+        current_block_ = 0;
+        offset_ = 0;
+    }
+
+    void* SessionArena::JsonResource::do_allocate(size_t bytes, size_t alignment) {
+        return arena_.allocate(bytes, alignment);
+    }
+
+    void SessionArena::JsonResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+        arena_.deallocate(p, bytes, alignment);
+    }
+
+    bool SessionArena::JsonResource::do_is_equal(const boost::json::memory_resource& other) const noexcept {
+        return this == &other;
+    }
+
+}  // namespace http_server
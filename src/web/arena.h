@@ -0,0 +1,132 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include <boost/json.hpp>
+
+namespace http_server {
+
+    //arena of one connection: request fields and body, response and json DOM are bump-allocated from blocks
+    //that the connection keeps between requests. Deallocation only counts; the arena rewinds to its first
+    //block as soon as nothing allocated from it is alive, so a keep-alive connection reaches a state
+    //without malloc calls per request
+    class SessionArena : public std::pmr::memory_resource {
+    public:
+        //a request moved into a strand operation may outlive its connection, so the arena is not
+        //destroyed by its owner directly: Release() deletes it with the last live allocation
+        struct Releaser {
+            void operator()(SessionArena* arena) const {
+                arena->Release();
+            }
+        };
+        using Ptr = std::unique_ptr<SessionArena, Releaser>;
+
+        static Ptr Create(size_t block_size = 16 * 1024) {
+            return Ptr(new SessionArena(block_size));
+        }
+
+        SessionArena(const SessionArena&) = delete;
+        SessionArena& operator=(const SessionArena&) = delete;
+
+        //the same arena as boost::json storage (boost::json has its own memory_resource base)
+        boost::json::storage_ptr JsonStorage() {
+            return boost::json::storage_ptr(&json_resource_);
+        }
+
+        //json storage of the arena behind "resource"; the default storage if "resource" is not an arena
+        static boost::json::storage_ptr JsonStorage(std::pmr::memory_resource* resource);
+
+    private:
+        class JsonResource : public boost::json::memory_resource {
+        public:
+            explicit JsonResource(SessionArena& arena) : arena_(arena) {}
+        private:
+            void* do_allocate(size_t bytes, size_t alignment) override;
+            void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+            bool do_is_equal(const boost::json::memory_resource& other) const noexcept override;
+
+            SessionArena& arena_;
+        };
+
+        struct Block {
+            std::unique_ptr<std::byte[]> data;
+            size_t size;
+        };
+
+        explicit SessionArena(size_t block_size);
+        ~SessionArena() = default;
+
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+        void Rewind();
+        void Release();
+
+        //memory kept after a rewind; blocks above it (e.g. after a large upload) are freed
+        static constexpr size_t MAX_RETAINED = 256 * 1024;
+
+        const size_t block_size_;
+        std::mutex mutex_;
+        std::vector<Block> blocks_;
+        size_t current_block_ = 0;
+        size_t offset_ = 0;
+        size_t live_allocations_ = 0;
+        bool released_ = false;
+        JsonResource json_resource_{ *this };
+    };
+
+    //allocator over a memory resource (e.g. SessionArena); unlike std::pmr::polymorphic_allocator it is
+    //assignable, which beast::http::basic_fields requires, and it follows the container it is moved with
+    template <typename T>
+    class ArenaAllocator {
+    public:
+        using value_type = T;
+        using propagate_on_container_copy_assignment = std::true_type;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        ArenaAllocator() noexcept : resource_(std::pmr::get_default_resource()) {}
+
+        ArenaAllocator(std::pmr::memory_resource* resource) noexcept : resource_(resource) {}
+
+        template <typename U>
+        ArenaAllocator(const ArenaAllocator<U>& other) noexcept : resource_(other.resource()) {}
+
+        T* allocate(size_t n) {
+            return static_cast<T*>(resource_->allocate(n * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T* p, size_t n) noexcept {
+            resource_->deallocate(p, n * sizeof(T), alignof(T));
+        }
+
+        std::pmr::memory_resource* resource() const noexcept {
+            return resource_;
+        }
+
+        template <typename U>
+        bool operator==(const ArenaAllocator<U>& other) const noexcept {
+            return resource_ == other.resource() || resource_->is_equal(*other.resource());
+        }
+
+    private:
+        std::pmr::memory_resource* resource_;
+    };
+
+    //memory resource behind an allocator of a request; other allocators get the default resource
+    template <typename Allocator>
+    std::pmr::memory_resource* ResourceOf(const Allocator&) {
+        return std::pmr::get_default_resource();
+    }
+
+    template <typename T>
+    std::pmr::memory_resource* ResourceOf(const ArenaAllocator<T>& allocator) {
+        return allocator.resource();
+    }
+
+}  // namespace http_server
@@ -0,0 +1,170 @@
+#include "compression.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include <boost/crc.hpp>
+
+namespace compression {
+
+    namespace zlib = boost::beast::zlib;
+
+    namespace {
+        std::string_view Trim(std::string_view str) {
+            while (!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+                str.remove_prefix(1);
+            while (!str.empty() && (str.back() == ' ' || str.back() == '\t'))
+                str.remove_suffix(1);
+            return str;
+        }
+
+        bool EqualsNoCase(std::string_view a, std::string_view b) {
+            return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+                return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+                });
+        }
+
+        //true unless the coding is listed with "q=0"
+        bool IsAcceptable(std::string_view params) {
+            auto q = params.find("q=");
+            if (q == std::string_view::npos)
+                return true;
+            auto value = Trim(params.substr(q + 2));
+            return value.find_first_not_of("0.") != std::string_view::npos;
+        }
+
+        void PutBigEndian32(std::string& out, uint32_t value) {
+            for (int shift = 24; shift >= 0; shift -= 8)
+                out.push_back(static_cast<char>(value >> shift));
+        }
+
+        void PutLittleEndian32(std::string& out, uint32_t value) {
+            for (int shift = 0; shift < 32; shift += 8)
+                out.push_back(static_cast<char>(value >> shift));
+        }
+
+        uint32_t Adler32(std::string_view data) {
+            constexpr uint32_t MOD = 65521;
+            uint32_t a = 1;
+            uint32_t b = 0;
+            while (!data.empty()) {
+                //5552 bytes is the most that can be summed before "b" may overflow
+                size_t chunk = std::min<size_t>(data.size(), 5552);
+                for (size_t i = 0; i < chunk; ++i) {
+                    a += static_cast<unsigned char>(data[i]);
+                    b += a;
+                }
+                a %= MOD;
+                b %= MOD;
+                data.remove_prefix(chunk);
+            }
+            return (b << 16) | a;
+        }
+
+        //raw deflate data appended to "out"
+        void Deflate(std::string_view data, int level, std::string& out) {
+            zlib::deflate_stream stream;
+            stream.reset(level, 15, 8, zlib::Strategy::normal);
+            size_t start = out.size();
+            out.resize(start + stream.upper_bound(data.size()));
+            zlib::z_params params;
+            params.next_in = data.data();
+            params.avail_in = data.size();
+            params.next_out = out.data() + start;
+            params.avail_out = out.size() - start;
+            boost::beast::error_code ec;
+            stream.write(params, zlib::Flush::finish, ec);
+            out.resize(out.size() - params.avail_out);
+        }
+    }
+
+    Encoding Negotiate(std::string_view accept_encoding) {
+        bool gzip = false;
+        bool deflate = false;
+        while (!accept_encoding.empty()) {
+            auto comma = accept_encoding.find(',');
+            auto item = accept_encoding.substr(0, comma);
+            accept_encoding = comma == std::string_view::npos ? std::string_view{} : accept_encoding.substr(comma + 1);
+            auto semicolon = item.find(';');
+            auto coding = Trim(item.substr(0, semicolon));
+            auto params = semicolon == std::string_view::npos ? std::string_view{} : item.substr(semicolon + 1);
+            if (EqualsNoCase(coding, "gzip"))
+                gzip = IsAcceptable(params);
+            else if (EqualsNoCase(coding, "deflate"))
+                deflate = IsAcceptable(params);
+        }
+        if (gzip)
+            return Encoding::Gzip;
+        if (deflate)
+            return Encoding::Deflate;
+        return Encoding::Identity;
+    }
+
+    std::string_view Name(Encoding encoding) {
+        switch (encoding) {
+        case Encoding::Gzip:
+            return "gzip";
+        case Encoding::Deflate:
+            return "deflate";
+        default:
+            return "identity";
+        }
+    }
+
+    std::string Compress(std::string_view data, Encoding encoding, int level) {
+        std::string out;
+        if (encoding == Encoding::Gzip) {
+            //RFC 1952: header without optional fields, deflate data, CRC-32 and size
+            static constexpr char HEADER[] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff' };
+            out.append(HEADER, sizeof(HEADER));
+            Deflate(data, level, out);
+            boost::crc_32_type crc;
+            crc.process_bytes(data.data(), data.size());
+            PutLittleEndian32(out, crc.checksum());
+            PutLittleEndian32(out, static_cast<uint32_t>(data.size()));
+        }
+        else {
+            //RFC 1950: zlib header (32K window), deflate data and Adler-32; this is what "deflate" means in HTTP
+            out.append("\x78\x9c", 2);
+            Deflate(data, level, out);
+            PutBigEndian32(out, Adler32(data));
+        }
+        return out;
+    }
+
+    bool IsCompressible(std::string_view content_type) {
+        return content_type.starts_with("text/") || content_type.starts_with("application/json")
+            || content_type.starts_with("application/javascript") || content_type.starts_with("application/xml")
+            || content_type.starts_with("image/svg+xml");
+    }
+
+    SharedBodyCache::Body SharedBodyCache::Get(const Body& body, Encoding encoding) {
+        auto index = static_cast<size_t>(encoding);
+        {
+            std::lock_guard lock(mutex_);
+            auto it = entries_.find(body.get());
+            if (it != entries_.end() && it->second.source.lock() == body && it->second.compressed[index])
+                return it->second.compressed[index];
+        }
+        //compressed outside of the lock; two threads may both do it once for a new body
+        auto compressed = std::make_shared<const std::string>(Compress(*body, encoding, level_));
+        std::lock_guard lock(mutex_);
+        auto& entry = entries_[body.get()];
+        if (entry.source.lock() != body)
+            entry = Entry{ body, {} };
+        entry.compressed[index] = compressed;
+        if (entries_.size() >= forget_at_)
+            ForgetExpired();
+        return compressed;
+    }
+
+    void SharedBodyCache::ForgetExpired() {
+        std::erase_if(entries_, [](const auto& item) {
+            return item.second.source.expired();
+            });
+        forget_at_ = std::max<size_t>(64, entries_.size() * 2);
+    }
+
+}  // namespace compression
@@ -0,0 +1,70 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace compression {
+
+    //content codings of responses
+    enum class Encoding {
+        Identity,
+        Gzip,
+        Deflate,
+        Count
+    };
+
+    //bodies shorter than this are sent as they are: the gain would not pay for the "Content-Encoding" header
+    constexpr size_t MIN_SIZE = 512;
+
+    constexpr int DEFAULT_LEVEL = 6;
+
+    //best coding that "accept_encoding" allows (gzip before deflate); Identity if there is none
+    Encoding Negotiate(std::string_view accept_encoding);
+
+    //value of the "Content-Encoding" header
+    std::string_view Name(Encoding encoding);
+
+    //"data" compressed with zlib "level" (1-9) into "encoding" (gzip or deflate)
+    std::string Compress(std::string_view data, Encoding encoding, int level);
+
+    //true for content types worth compressing (text, json, ...); images and other packed formats are not
+    bool IsCompressible(std::string_view content_type);
+
+    //compressed copies of shared bodies (e.g. state snapshots): a body is compressed once per coding,
+    //however many responses send it. Entries go away with their bodies. May be used from any thread
+    class SharedBodyCache {
+    public:
+        using Body = std::shared_ptr<const std::string>;
+
+        explicit SharedBodyCache(int level = DEFAULT_LEVEL) : level_(level) {
+        }
+
+        void SetLevel(int level) {
+            level_ = level;
+        }
+
+        int GetLevel() const {
+            return level_;
+        }
+
+        Body Get(const Body& body, Encoding encoding);
+
+    private:
+        struct Entry {
+            std::weak_ptr<const std::string> source;
+            std::array<Body, static_cast<size_t>(Encoding::Count)> compressed;
+        };
+
+        void ForgetExpired();
+
+        int level_;
+        std::mutex mutex_;
+        std::unordered_map<const std::string*, Entry> entries_;
+        size_t forget_at_ = 64;
+    };
+
+}  // namespace compression
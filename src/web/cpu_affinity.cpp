@@ -0,0 +1,140 @@
+#include "cpu_affinity.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace cpu_affinity {
+
+    namespace {
+        unsigned ParseCpu(std::string_view number) {
+            unsigned cpu = 0;
+            auto [ptr, ec] = std::from_chars(number.data(), number.data() + number.size(), cpu);
+            if (ec != std::errc() || ptr != number.data() + number.size())
+                throw std::invalid_argument("Invalid cpu list: " + std::string(number));
+            return cpu;
+        }
+
+        std::string_view Trim(std::string_view str) {
+            while (!str.empty() && std::isspace(static_cast<unsigned char>(str.front())))
+                str.remove_prefix(1);
+            while (!str.empty() && std::isspace(static_cast<unsigned char>(str.back())))
+                str.remove_suffix(1);
+            return str;
+        }
+    }
+
+    CpuSet ParseCpuList(std::string_view list) {
+        CpuSet cpus;
+        while (!list.empty()) {
+            auto comma = list.find(',');
+            auto item = Trim(list.substr(0, comma));
+            list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+            if (item.empty())
+                continue;
+            auto dash = item.find('-');
+            if (dash == std::string_view::npos) {
+                cpus.push_back(ParseCpu(item));
+                continue;
+            }
+            unsigned first = ParseCpu(item.substr(0, dash));
+            unsigned last = ParseCpu(item.substr(dash + 1));
+            if (first > last)
+                throw std::invalid_argument("Invalid cpu range: " + std::string(item));
+            for (unsigned cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        }
+        std::sort(cpus.begin(), cpus.end());
+        cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+        return cpus;
+    }
+
+#ifdef __linux__
+    CpuSet AllowedCpus() {
+        CpuSet cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) != 0)
+            return cpus;
+        for (unsigned cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET(cpu, &set))
+                cpus.push_back(cpu);
+        return cpus;
+    }
+
+    bool PinThread(std::thread::native_handle_type thread, const CpuSet& cpus) {
+        if (cpus.empty())
+            return false;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (auto cpu : cpus)
+            if (cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+    }
+
+    bool PinCurrentThread(const CpuSet& cpus) {
+        return PinThread(pthread_self(), cpus);
+    }
+#else
+    CpuSet AllowedCpus() {
+        CpuSet cpus;
+        for (unsigned cpu = 0; cpu < std::thread::hardware_concurrency(); ++cpu)
+            cpus.push_back(cpu);
+        return cpus;
+    }
+
+    bool PinThread(std::thread::native_handle_type, const CpuSet&) {
+        return false;
+    }
+
+    bool PinCurrentThread(const CpuSet&) {
+        return false;
+    }
+#endif
+
+    const std::map<unsigned, int>& CpuToNode() {
+        static const std::map<unsigned, int> cpu_to_node = [] {
+            std::map<unsigned, int> result;
+            const std::filesystem::path nodes_dir = "/sys/devices/system/node";
+            std::error_code ec;
+            for (auto& entry : std::filesystem::directory_iterator(nodes_dir, ec)) {
+                std::string name = entry.path().filename().string();
+                if (name.rfind("node", 0) != 0 || name.size() == 4 || !std::isdigit(static_cast<unsigned char>(name[4])))
+                    continue;
+                std::ifstream file(entry.path() / "cpulist");
+                std::string list;
+                std::getline(file, list);
+                try {
+                    for (auto cpu : ParseCpuList(list))
+                        result[cpu] = std::stoi(name.substr(4));
+                }
+                catch (const std::exception&) {
+                }
+            }
+            return result;
+        }();
+        return cpu_to_node;
+    }
+
+    std::vector<int> NodesOf(const CpuSet& cpus) {
+        std::vector<int> nodes;
+        for (auto cpu : cpus) {
+            auto it = CpuToNode().find(cpu);
+            nodes.push_back(it == CpuToNode().end() ? -1 : it->second);
+        }
+        std::sort(nodes.begin(), nodes.end());
+        nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+        return nodes;
+    }
+
+}  // namespace cpu_affinity
@@ -0,0 +1,28 @@
+#pragma once
+#include <map>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace cpu_affinity {
+
+    using CpuSet = std::vector<unsigned>;
+
+    //"0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}; throws std::invalid_argument on malformed lists
+    CpuSet ParseCpuList(std::string_view list);
+
+    //cpus the process may run on right now
+    CpuSet AllowedCpus();
+
+    //restricts the thread to "cpus"; false if the platform does not support it or the call failed
+    bool PinThread(std::thread::native_handle_type thread, const CpuSet& cpus);
+
+    bool PinCurrentThread(const CpuSet& cpus);
+
+    //cpu -> NUMA node as reported by /sys/devices/system/node; empty if the topology is unknown
+    const std::map<unsigned, int>& CpuToNode();
+
+    //NUMA nodes of "cpus" (-1 for cpus of unknown node), without duplicates
+    std::vector<int> NodesOf(const CpuSet& cpus);
+
+}  // namespace cpu_affinity
@@ -0,0 +1,64 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/core/file.hpp>
+#include <boost/beast/http/error.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/optional.hpp>
+
+namespace http_server {
+
+    //body of "length" bytes of an open file from "offset" on. Session sends it with sendfile(2) straight from
+    //the page cache where it can (see SessionBase::Write); the writer below is the portable fallback
+    struct FileRangeBody {
+        struct value_type {
+            boost::beast::file file;
+            std::uint64_t offset = 0;
+            std::uint64_t length = 0;
+        };
+
+        static std::uint64_t size(const value_type& body) {
+            return body.length;
+        }
+
+        class writer {
+        public:
+            using const_buffers_type = boost::asio::const_buffer;
+
+            template <bool isRequest, typename Fields>
+            writer(const boost::beast::http::header<isRequest, Fields>&, value_type& body) : body_(body), remaining_(body.length) {
+            }
+
+            void init(boost::beast::error_code& ec) {
+                body_.file.seek(body_.offset, ec);
+            }
+
+            boost::optional<std::pair<const_buffers_type, bool>> get(boost::beast::error_code& ec) {
+                ec = {};
+                if (remaining_ == 0)
+                    return boost::none;
+                auto amount = static_cast<std::size_t>(std::min<std::uint64_t>(remaining_, buffer_.size()));
+                auto read = body_.file.read(buffer_.data(), amount, ec);
+                if (ec)
+                    return boost::none;
+                if (read == 0) {
+                    ec = boost::beast::http::error::short_read;
+                    return boost::none;
+                }
+                remaining_ -= read;
+                return { { boost::asio::const_buffer(buffer_.data(), read), remaining_ > 0 } };
+            }
+
+        private:
+            value_type& body_;
+            std::uint64_t remaining_;
+            std::array<char, 64 * 1024> buffer_;
+        };
+    };
+
+}  // namespace http_server
@@ -0,0 +1,57 @@
+#include "file_types.h"
+
+#include <cctype>
+
+namespace http_handler {
+
+    std::string GetFileType(std::string file_name) {
+        std::string answ;
+        auto it = file_name.rbegin();
+        while (it != file_name.rend() && *it != '.') {
+            *it = std::tolower(*it);
+            answ = *(it++) + answ;
+        }
+        if (answ == "htm" || answ == "html")
+            return "text/html";
+        if (answ == "css")
+            return "text/css";
+        if (answ == "txt")
+            return "text/plain";
+        if (answ == "js")
+            return "text/javascript";
+        if (answ == "json")
+            return "application/json";
+        if (answ == "xml")
+            return "application/xml";
+        if (answ == "png")
+            return "image/png";
+        if (answ == "jpg" || answ == "jpeg" || answ == "jpe")
+            return "image/jpeg";
+        if (answ == "gif")
+            return "image/gif";
+        if (answ == "bmp")
+            return "image/bmp";
+        if (answ == "ico")
+            return "image/vnd.microsoft.icon";
+        if (answ == "tiff" || answ == "tif")
+            return "image/tiff";
+        if (answ == "svg" || answ == "svgz")
+            return "image/svg+xml";
+        if (answ == "mp3")
+            return "audio/mpeg";
+        return "application/octet-stream";
+    }
+
+    bool IsAccessibleFile(fs::path file_path, fs::path base_path) {
+        file_path = fs::weakly_canonical(file_path);
+        base_path = fs::weakly_canonical(base_path);
+
+        for (auto b = base_path.begin(), p = file_path.begin(); b != base_path.end(); ++b, ++p) {
+            if (p == file_path.end() || *p != *b) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+}  // namespace http_handler
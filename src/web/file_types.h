@@ -0,0 +1,15 @@
+#pragma once
+#include <filesystem>
+#include <string>
+
+namespace http_handler {
+
+    namespace fs = std::filesystem;
+
+    //content type of a file by its extension; "application/octet-stream" for an unknown one
+    std::string GetFileType(std::string file_name);
+
+    //true if "file_path" lies inside "base_path" once both are made canonical
+    bool IsAccessibleFile(fs::path file_path, fs::path base_path);
+
+}  // namespace http_handler
@@ -1,5 +1,9 @@
 #include "http_server.h"
 
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#endif
+
 
 namespace http_server {
 
@@ -8,8 +12,8 @@ namespace http_server {
 		net::dispatch(stream_.get_executor(), beast::bind_front_handler(&SessionBase::Read, GetSharedThis()));
 	}
     void SessionBase::Read() {
-        request_ = {};
-        stream_.expires_after(30s);
+        request_ = MakeRequest();
+        stream_.expires_after(READ_TIMEOUT);
         http::async_read(stream_, buffer_, request_,
             beast::bind_front_handler(&SessionBase::OnRead, GetSharedThis()));
     }
@@ -20,6 +24,8 @@ namespace http_server {
             ServerErrorLog(ec.value(), ec.message(), "read");
             return;
         }
+        if (websocket::is_upgrade(request_))
+            return HandleUpgrade(std::move(request_));
         HandleRequest(std::move(request_));
     }
     void SessionBase::OnWrite(bool close, beast::error_code ec, [[maybe_unused]] std::size_t bytes_written) {
@@ -31,6 +37,60 @@ namespace http_server {
            return Close();
         Read();
     }
+    std::shared_ptr<WebSocketSession> SessionBase::AcceptWebSocket(HttpRequest&& upgrade, WebSocketSession::FrameHandler on_frame, WebSocketSession::CloseHandler on_close) {
+        auto ws = std::make_shared<WebSocketSession>(std::move(stream_), std::move(on_frame), std::move(on_close));
+        ws->Run(std::move(upgrade));
+        return ws;
+    }
+    void SessionBase::SendFile(std::shared_ptr<FileTransfer> transfer) {
+#if defined(__linux__) && BOOST_BEAST_USE_POSIX_FILE
+        //one call moves at most this much, so a large file does not hold up the other connections of the thread
+        constexpr std::uint64_t MAX_CHUNK = 1024 * 1024;
+        auto& socket = stream_.socket();
+        socket.native_non_blocking(true);
+        while (transfer->remaining > 0) {
+            off_t offset = static_cast<off_t>(transfer->offset);
+            ssize_t sent = ::sendfile(socket.native_handle(), transfer->file, &offset, std::min(transfer->remaining, MAX_CHUNK));
+            if (sent > 0) {
+                transfer->offset += sent;
+                transfer->remaining -= sent;
+                transfer->written += sent;
+                continue;
+            }
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                //the raw wait is not covered by the timeouts of tcp_stream: a client that stops reading is cut off
+                //by a timer of its own, so it cannot keep the session and the file open
+                if (!transfer->deadline)
+                    transfer->deadline.emplace(stream_.get_executor());
+                transfer->deadline->expires_after(WRITE_TIMEOUT);
+                transfer->deadline->async_wait([self = GetSharedThis(), transfer](sys::error_code ec) {
+                    if (ec)
+                        return;
+                    transfer->timed_out = true;
+                    self->stream_.socket().cancel(ec);
+                    });
+                socket.async_wait(tcp::socket::wait_write, [self = GetSharedThis(), transfer](sys::error_code ec) {
+                    transfer->deadline->cancel();
+                    if (transfer->timed_out)
+                        ec = beast::error::timeout;
+                    if (ec)
+                        return self->OnWrite(false, ec, transfer->written);
+                    self->SendFile(transfer);
+                    });
+                return;
+            }
+            //0 means the file got shorter than the announced "Content-Length"
+            sys::error_code ec = sent == 0 ? sys::error_code(http::error::short_read) : sys::error_code(errno, sys::system_category());
+            return OnWrite(false, ec, transfer->written);
+        }
+        OnWrite(transfer->close, {}, transfer->written);
+#endif
+    }
+    HttpRequest SessionBase::MakeRequest() {
+        return HttpRequest(std::piecewise_construct, std::make_tuple(GetAllocator()), std::make_tuple(GetAllocator()));
+    }
     void SessionBase::Close() {
         beast::error_code ec;
         stream_.socket().shutdown(tcp::socket::shutdown_send, ec);
@@ -1,9 +1,17 @@
 #pragma once
 //#include "sdk.h"
+#include <concepts>
 #include <iostream>
+#include <optional>
+#include <stdexcept>
 #include "log.h"
+#include "arena.h"
+#include "websocket_session.h"
+#include "file_range_body.h"
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/strand.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 
@@ -23,33 +31,115 @@ namespace http_server {
 
     class SessionBase {
     public:
+        //a request must arrive within READ_TIMEOUT of the previous answer (keep-alive idle time included); an
+        //answer gets its own WRITE_TIMEOUT from the moment it is written, however long it was prepared
+        static constexpr auto READ_TIMEOUT = 30s;
+        static constexpr auto WRITE_TIMEOUT = 30s;
+
         SessionBase(const SessionBase&) = delete;
         SessionBase& operator=(const SessionBase&) = delete;
         void Run();
     protected:
-        SessionBase(tcp::socket&& socket) :stream_(std::move(socket)) {}
-        using HttpRequest = http::request<http::string_body>;
+        SessionBase(tcp::socket&& socket) :stream_(std::move(socket)), request_(MakeRequest()) {
+            sys::error_code ec;
+            remote_address_ = stream_.socket().remote_endpoint(ec).address();
+        }
+
+        //address of the client; unspecified if it could not be read
+        const net::ip::address& RemoteAddress() const {
+            return remote_address_;
+        }
 
+        //may be called from any thread (e.g. the game strand); the write itself starts on the connection's executor
         template<typename Body, typename Fields>
         void Write(http::response<Body, Fields>&& response) {
-            auto safe_response = std::make_shared<http::response<Body, Fields>>(std::move(response));
+            auto safe_response = std::allocate_shared<http::response<Body, Fields>>(GetAllocator(), std::move(response));
             auto self = GetSharedThis();
-            http::async_write(stream_, *safe_response, [safe_response, self](beast::error_code ec, std::size_t bytes_written) {
-                self->OnWrite(safe_response->need_eof(), ec, bytes_written);
+            net::dispatch(stream_.get_executor(), [safe_response, self]() {
+                self->stream_.expires_after(WRITE_TIMEOUT);
+#if defined(__linux__) && BOOST_BEAST_USE_POSIX_FILE
+                if constexpr (std::is_same_v<Body, FileRangeBody>) {
+                    self->WriteFileRange(safe_response);
+                    return;
+                }
+#endif
+                http::async_write(self->stream_, *safe_response, [safe_response, self](beast::error_code ec, std::size_t bytes_written) {
+                    self->OnWrite(safe_response->need_eof(), ec, bytes_written);
+                    });
                 });
         }
         ~SessionBase() = default;
+
+        //hands the connection over to a websocket session that answers "upgrade"; this session ends here
+        std::shared_ptr<WebSocketSession> AcceptWebSocket(HttpRequest&& upgrade, WebSocketSession::FrameHandler on_frame, WebSocketSession::CloseHandler on_close);
     private:
+        //file part of a FileRangeBody response that is being sent with sendfile(2)
+        struct FileTransfer {
+            std::shared_ptr<void> response;     //keeps the file open
+            int file;
+            std::uint64_t offset;
+            std::uint64_t remaining;
+            bool close;
+            std::size_t written = 0;
+            std::optional<net::steady_timer> deadline;   //of the current wait for the socket
+            bool timed_out = false;
+        };
+
+        //the header goes out through beast, the body straight from the page cache to the socket
+        template<typename Fields>
+        void WriteFileRange(const std::shared_ptr<http::response<FileRangeBody, Fields>>& response) {
+            auto serializer = std::make_shared<http::response_serializer<FileRangeBody, Fields>>(*response);
+            auto self = GetSharedThis();
+            http::async_write_header(stream_, *serializer, [response, serializer, self](beast::error_code ec, std::size_t bytes_written) {
+                if (ec)
+                    return self->OnWrite(false, ec, bytes_written);
+                auto& body = response->body();
+                auto transfer = std::make_shared<FileTransfer>(FileTransfer{ response, body.file.native_handle(), body.offset, body.length, response->need_eof() });
+                transfer->written = bytes_written;
+                self->SendFile(std::move(transfer));
+                });
+        }
+        void SendFile(std::shared_ptr<FileTransfer> transfer);
         void Read();
         void OnRead(beast::error_code ec, [[maybe_unused]] std::size_t bytes_read);
         void OnWrite(bool close, beast::error_code ec, [[maybe_unused]] std::size_t bytes_written);
         void Close();
+        HttpRequest MakeRequest();
+        ArenaAllocator<char> GetAllocator() {
+            return ArenaAllocator<char>(arena_.get());
+        }
         beast::tcp_stream stream_;
         beast::flat_buffer buffer_;
+        SessionArena::Ptr arena_ = SessionArena::Create();
         HttpRequest request_;
+        net::ip::address remote_address_;
 
         virtual std::shared_ptr<SessionBase> GetSharedThis() = 0;
         virtual void HandleRequest(HttpRequest&& request) = 0;
+        virtual void HandleUpgrade(HttpRequest&& request) = 0;
+    };
+
+    //one handler shared by all listeners and sessions; passes websocket upgrades on if the handler takes them
+    template <typename Handler>
+    class HandlerRef {
+    public:
+        explicit HandlerRef(Handler& handler) : handler_(&handler) {
+        }
+
+        template <typename Request, typename Send, typename... Args>
+            requires std::invocable<Handler&, Request&&, Send&&, Args&&...>
+        void operator()(Request&& req, Send&& send, Args&&... args) const {
+            (*handler_)(std::forward<Request>(req), std::forward<Send>(send), std::forward<Args>(args)...);
+        }
+
+        template <typename Request, typename Send, typename Accept, typename... Args>
+            requires requires (Handler& handler, Request&& req, Send& send, Accept& accept, Args&&... args) { handler.Upgrade(std::move(req), send, accept, std::forward<Args>(args)...); }
+        void Upgrade(Request&& req, Send& send, Accept& accept, Args&&... args) const {
+            handler_->Upgrade(std::move(req), send, accept, std::forward<Args>(args)...);
+        }
+
+    private:
+        Handler* handler_;
     };
 
     template <typename RequestHandler>
@@ -63,24 +153,58 @@ namespace http_server {
         std::shared_ptr<SessionBase> GetSharedThis() override {
             return this->shared_from_this();
         }
+        //a handler that takes the remote address (e.g. for rate limits) gets it as the third argument
         void HandleRequest(HttpRequest&& request) override {
-            request_handler_(std::move(request), [self = this->shared_from_this()](auto&& response) {
+            auto send = [self = this->shared_from_this()](auto&& response) {
                 self->Write(std::move(response));
-                });
+                };
+            if constexpr (requires { request_handler_(std::move(request), std::move(send), RemoteAddress()); })
+                request_handler_(std::move(request), std::move(send), RemoteAddress());
+            else
+                request_handler_(std::move(request), std::move(send));
+        }
+        //a handler without "Upgrade" gets the upgrade request as an ordinary one; the remote address goes along
+        //as in HandleRequest
+        void HandleUpgrade(HttpRequest&& request) override {
+            auto send = [self = this->shared_from_this()](auto&& response) {
+                self->Write(std::move(response));
+                };
+            auto accept = [self = this->shared_from_this()](HttpRequest&& upgrade, WebSocketSession::FrameHandler on_frame, WebSocketSession::CloseHandler on_close) {
+                return self->AcceptWebSocket(std::move(upgrade), std::move(on_frame), std::move(on_close));
+                };
+            if constexpr (requires { request_handler_.Upgrade(std::move(request), send, accept, RemoteAddress()); })
+                request_handler_.Upgrade(std::move(request), send, accept, RemoteAddress());
+            else if constexpr (requires { request_handler_.Upgrade(std::move(request), send, accept); })
+                request_handler_.Upgrade(std::move(request), send, accept);
+            else
+                HandleRequest(std::move(request));
         }
     };
 
+#ifdef SO_REUSEPORT
+    using reuse_port = net::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+
     template <typename RequestHandler>
     class Listener : public std::enable_shared_from_this<Listener<RequestHandler>> {
     public:
+        // with "share_port" several listeners (one per io_context) may be bound to the same endpoint,
+        // the kernel spreads incoming connections between them
         template <typename Handler>
-        Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler) :
+        Listener(net::io_context& ioc, const tcp::endpoint& endpoint, Handler&& request_handler, bool share_port = false) :
             ioc_(ioc),
             acceptor_(net::make_strand(ioc)),
             request_handler_(std::forward<Handler>(request_handler))
         {
             acceptor_.open(endpoint.protocol());
             acceptor_.set_option(net::socket_base::reuse_address(true));
+            if (share_port) {
+#ifdef SO_REUSEPORT
+                acceptor_.set_option(reuse_port(true));
+#else
+                throw std::runtime_error("SO_REUSEPORT is not supported on this platform");
+#endif
+            }
             acceptor_.bind(endpoint);
             acceptor_.listen(net::socket_base::max_listen_connections);
         }
@@ -110,9 +234,9 @@ namespace http_server {
     };
 
     template <typename RequestHandler>
-    void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler) {
+    void ServeHttp(net::io_context& ioc, const tcp::endpoint& endpoint, RequestHandler&& handler, bool share_port = false) {
         using MyListener = Listener<std::decay_t<RequestHandler>>;
-        std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler))->Run();
+        std::make_shared<MyListener>(ioc, endpoint, std::forward<RequestHandler>(handler), share_port)->Run();
     }
 
 }  // namespace http_server
@@ -38,4 +38,8 @@ void ServerErrorLog(unsigned code, std::string_view message, std::string_view pl
         {"where", place}
     };
     BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, data) << "error";
+}
+
+void ThreadPlacementLog(const boost::json::value& placement) {
+    BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, placement) << "thread placement";
 }
\ No newline at end of file
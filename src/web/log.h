@@ -22,4 +22,6 @@ void ServerStartLog(unsigned port, boost::asio::ip::address ip);
 
 void ServerStopLog(unsigned returns_code, std::string_view ex = "");
 
-void ServerErrorLog(unsigned code, std::string_view message, std::string_view place);
\ No newline at end of file
+void ServerErrorLog(unsigned code, std::string_view message, std::string_view place);
+
+void ThreadPlacementLog(const boost::json::value& placement);
\ No newline at end of file
@@ -0,0 +1,53 @@
+#include "map_responses.h"
+
+#include <vector>
+
+#include <boost/json.hpp>
+
+#include "../binary_tools/binary_writer.h"
+
+namespace http_handler {
+
+    namespace json = boost::json;
+
+    namespace {
+        //entry of "/api/v1/maps"
+        struct MapInfo {
+            model::Map::Id id_;
+            std::string name_;
+            MapInfo(const model::Map& map):id_(map.GetId()), name_(map.GetName()) {
+            }
+        };
+
+        void tag_invoke(json::value_from_tag, json::value& jv, MapInfo const& map_info) {
+            jv = {
+                {"id", *map_info.id_},
+                {"name", map_info.name_}
+            };
+        }
+
+        std::string GetMaps(const model::Game& game) {
+            std::vector<MapInfo> maps_info;
+            for (const auto& map : game.GetMaps())
+                maps_info.emplace_back(map);
+            return json::serialize(json::value_from(maps_info));
+        }
+    }
+
+    MapResponses::MapResponses(const model::Game& game, const extra_data::Json_data& loot_types) {
+        list_ = MakeAsset(GetMaps(game), "application/json");
+        for (const auto& map : game.GetMaps()) {
+            const auto& id = *map.GetId();
+            const auto& map_loot_types = loot_types.Get(id);
+            std::string binary;
+            binary_writer::BinaryWriter writer(binary);
+            binary_writer::WriteMap(writer, map, json::serialize(map_loot_types));
+            maps_.emplace(id, MapAssets{
+                MakeAsset(json::serialize(json::value_from(std::pair<model::Map, json::array>(map, map_loot_types))), "application/json"),
+                MakeAsset(std::move(binary), std::string(binary_writer::CONTENT_TYPE)),
+                MapTiles(map)
+                });
+        }
+    }
+
+}  // namespace http_handler
@@ -0,0 +1,49 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "static_files.h"
+#include "map_tiles.h"
+#include "../model/model.h"
+#include "../extra/extra_data.h"
+
+namespace http_handler {
+
+    //bodies of "/api/v1/maps", "/api/v1/maps/{id}" and its tiles, serialized once: maps do not change while the server runs
+    class MapResponses {
+    public:
+        struct MapAssets {
+            StaticAsset json;
+            StaticAsset binary;
+            MapTiles tiles;
+        };
+
+        MapResponses(const model::Game& game, const extra_data::Json_data& loot_types);
+
+        const StaticAsset& GetList() const {
+            return list_;
+        }
+
+        //nullptr if there is no such map
+        const MapAssets* Find(std::string_view id) const {
+            auto it = maps_.find(id);
+            return it == maps_.end() ? nullptr : &it->second;
+        }
+
+    private:
+        //lookup by std::string_view without making a string
+        struct IdHash {
+            using is_transparent = void;
+
+            size_t operator()(std::string_view id) const {
+                return std::hash<std::string_view>{}(id);
+            }
+        };
+
+        StaticAsset list_;
+        std::unordered_map<std::string, MapAssets, IdHash, std::equal_to<>> maps_;
+    };
+
+}  // namespace http_handler
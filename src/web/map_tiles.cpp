@@ -0,0 +1,132 @@
+#include "map_tiles.h"
+
+#include <algorithm>
+#include <string>
+
+#include "boost/json.hpp"
+
+namespace http_handler {
+
+    namespace json = boost::json;
+
+    namespace {
+        //bounds of an object in map units: first and last point on each axis
+        struct Bounds {
+            double x0, y0, x1, y1;
+        };
+
+        Bounds GetBounds(const model::Road& road) {
+            auto start = road.GetStart();
+            auto end = road.GetEnd();
+            const double half = model::WIDTH_OF_ROAD;
+            return { std::min(start.x, end.x) - half, std::min(start.y, end.y) - half, std::max(start.x, end.x) + half, std::max(start.y, end.y) + half };
+        }
+
+        Bounds GetBounds(const model::Building& building) {
+            auto& rect = building.GetBounds();
+            return { double(rect.position.x), double(rect.position.y), double(rect.position.x + rect.size.width), double(rect.position.y + rect.size.height) };
+        }
+
+        Bounds GetBounds(const model::Office& office) {
+            return { double(office.GetPosition().x), double(office.GetPosition().y), double(office.GetPosition().x), double(office.GetPosition().y) };
+        }
+
+        //objects of one tile, as indices in the map arrays
+        struct TileContent {
+            std::vector<size_t> roads;
+            std::vector<size_t> buildings;
+            std::vector<size_t> offices;
+        };
+
+        //json of every object, serialized once for all the tiles it is in
+        template <typename Object>
+        std::vector<std::string> SerializeAll(const std::vector<Object>& objects, bool with_index) {
+            std::vector<std::string> result;
+            result.reserve(objects.size());
+            for (size_t i = 0; i < objects.size(); ++i) {
+                auto jv = json::value_from(objects[i]);
+                if (with_index)
+                    jv.as_object()["index"] = i;
+                result.push_back(json::serialize(jv));
+            }
+            return result;
+        }
+
+        void AppendArray(std::string& body, std::string_view name, const std::vector<size_t>& indices, const std::vector<std::string>& serialized) {
+            body += '"';
+            body += name;
+            body += "\":[";
+            for (size_t i = 0; i < indices.size(); ++i) {
+                if (i > 0)
+                    body += ',';
+                body += serialized[indices[i]];
+            }
+            body += ']';
+        }
+
+        std::string TileBody(const TileContent& content, const std::vector<std::string>& roads, const std::vector<std::string>& buildings, const std::vector<std::string>& offices) {
+            std::string body = "{";
+            AppendArray(body, "roads", content.roads, roads);
+            body += ',';
+            AppendArray(body, "buildings", content.buildings, buildings);
+            body += ',';
+            AppendArray(body, "offices", content.offices, offices);
+            body += '}';
+            return body;
+        }
+    }
+
+    MapTiles::MapTiles(const model::Map& map) {
+        double far = 0;
+        const auto extend = [&far](const Bounds& bounds) {
+            far = std::max({ far, bounds.x1, bounds.y1 });
+            };
+        for (auto& road : map.GetRoads())
+            extend(GetBounds(road));
+        for (auto& building : map.GetBuildings())
+            extend(GetBounds(building));
+        for (auto& office : map.GetOffices())
+            extend(GetBounds(office));
+        while (extent_ <= far)
+            extent_ *= 2;
+        while (max_zoom_ < MAX_ZOOM && (extent_ >> (max_zoom_ + 1)) >= MIN_TILE_SIZE)
+            ++max_zoom_;
+
+        grid_ = MakeAsset(json::serialize(json::value{ {"extent", extent_}, {"maxZoom", max_zoom_} }), "application/json");
+        empty_ = MakeAsset(TileBody({}, {}, {}, {}), "application/json");
+
+        auto roads = SerializeAll(map.GetRoads(), true);
+        auto buildings = SerializeAll(map.GetBuildings(), true);
+        auto offices = SerializeAll(map.GetOffices(), false);
+        tiles_.resize(max_zoom_ + 1);
+        for (unsigned z = 0; z <= max_zoom_; ++z) {
+            const double size = double(extent_ >> z);
+            const uint64_t last = (uint64_t{ 1 } << z) - 1;
+            std::unordered_map<uint64_t, TileContent> contents;
+            const auto place = [&](const Bounds& bounds, auto member, size_t index) {
+                auto tile = [size, last](double coord) {
+                    return std::min<uint64_t>(static_cast<uint64_t>(std::max(coord, 0.) / size), last);
+                    };
+                for (auto x = tile(bounds.x0); x <= tile(bounds.x1); ++x)
+                    for (auto y = tile(bounds.y0); y <= tile(bounds.y1); ++y)
+                        (contents[Key(x, y)].*member).push_back(index);
+                };
+            for (size_t i = 0; i < map.GetRoads().size(); ++i)
+                place(GetBounds(map.GetRoads()[i]), &TileContent::roads, i);
+            for (size_t i = 0; i < map.GetBuildings().size(); ++i)
+                place(GetBounds(map.GetBuildings()[i]), &TileContent::buildings, i);
+            for (size_t i = 0; i < map.GetOffices().size(); ++i)
+                place(GetBounds(map.GetOffices()[i]), &TileContent::offices, i);
+            for (auto& [key, content] : contents)
+                tiles_[z].emplace(key, MakeAsset(TileBody(content, roads, buildings, offices), "application/json"));
+        }
+    }
+
+    const StaticAsset* MapTiles::Find(unsigned z, uint64_t x, uint64_t y) const {
+        if (z > max_zoom_ || x >> z != 0 || y >> z != 0)
+            return nullptr;
+        auto it = tiles_[z].find(Key(x, y));
+        return it == tiles_[z].end() ? &empty_ : &it->second;
+    }
+
+}  // namespace http_handler
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "static_files.h"
+#include "../model/model.h"
+
+namespace http_handler {
+
+    //roads, buildings and offices of a map split into square tiles, for maps too large to send at once.
+    //The map (from (0, 0) to "extent") is tile (0, 0) of zoom 0; every zoom halves the tile side down to
+    //MIN_TILE_SIZE. An object is in every tile it touches. All bodies are built with the map
+    class MapTiles {
+    public:
+        static constexpr model::Dimension MIN_TILE_SIZE = 32;
+        static constexpr unsigned MAX_ZOOM = 12;
+
+        explicit MapTiles(const model::Map& map);
+
+        //{"extent":..,"maxZoom":..}
+        const StaticAsset& GetGrid() const {
+            return grid_;
+        }
+
+        //nullptr if there is no such tile
+        const StaticAsset* Find(unsigned z, uint64_t x, uint64_t y) const;
+
+    private:
+        static uint64_t Key(uint64_t x, uint64_t y) {
+            return (x << 32) | y;
+        }
+
+        model::Dimension extent_ = MIN_TILE_SIZE;
+        unsigned max_zoom_ = 0;
+        StaticAsset grid_;
+        StaticAsset empty_;
+        //zoom -> key of a tile -> its body; tiles without objects are not kept
+        std::vector<std::unordered_map<uint64_t, StaticAsset>> tiles_;
+    };
+
+}  // namespace http_handler
@@ -0,0 +1,134 @@
+#include "rate_limiter.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <random>
+
+namespace http_handler {
+
+    namespace {
+        //splitmix64 finalizer
+        uint64_t Mix(uint64_t value) {
+            value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+            value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+            return value ^ (value >> 31);
+        }
+
+        enum KeyKind : uint64_t {
+            ADDRESS_V4,
+            ADDRESS_V6,
+            TOKEN
+        };
+
+        uint64_t Seed(unsigned endpoint, KeyKind kind) {
+            return Mix((uint64_t{ endpoint } << 2) | kind);
+        }
+    }
+
+    std::optional<std::pair<std::string_view, RateLimit>> ParseRateLimit(std::string_view option) {
+        auto equals = option.find('=');
+        if (equals == std::string_view::npos || equals == 0)
+            return std::nullopt;
+        auto name = option.substr(0, equals);
+        auto value = option.substr(equals + 1);
+        auto slash = value.find('/');
+        auto rate_str = value.substr(0, slash);
+
+        RateLimit limit;
+        auto [rate_end, rate_ec] = std::from_chars(rate_str.data(), rate_str.data() + rate_str.size(), limit.rate);
+        if (rate_str.empty() || rate_ec != std::errc{} || rate_end != rate_str.data() + rate_str.size() || !(limit.rate > 0))
+            return std::nullopt;
+        //without a burst a second's worth of requests may come at once
+        limit.burst = static_cast<unsigned>(std::max(1.0, std::ceil(limit.rate)));
+        if (slash != std::string_view::npos) {
+            auto burst_str = value.substr(slash + 1);
+            auto [burst_end, burst_ec] = std::from_chars(burst_str.data(), burst_str.data() + burst_str.size(), limit.burst);
+            if (burst_str.empty() || burst_ec != std::errc{} || burst_end != burst_str.data() + burst_str.size() || limit.burst == 0)
+                return std::nullopt;
+        }
+        return std::make_pair(name, limit);
+    }
+
+    RateLimiter::RateLimiter() : shards_(std::make_unique<Shard[]>(SHARDS)), seed_(Mix(std::random_device{}() ^ (uint64_t{ std::random_device{}() } << 32))) {
+        for (size_t i = 0; i < SHARDS; ++i) {
+            for (auto& slot : shards_[i].slots)
+                slot.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    uint64_t RateLimiter::Key(const boost::asio::ip::address& address, unsigned endpoint) {
+        if (address.is_v4())
+            return Mix(Seed(endpoint, ADDRESS_V4) ^ address.to_v4().to_uint());
+        //an IPv6 client usually owns a whole /64, so the buckets are kept per prefix
+        auto bytes = address.to_v6().to_bytes();
+        uint64_t prefix = 0;
+        for (size_t i = 0; i < 8; ++i)
+            prefix = (prefix << 8) | bytes[i];
+        return Mix(Seed(endpoint, ADDRESS_V6) ^ prefix);
+    }
+
+    uint64_t RateLimiter::Key(const app::Token128& token, unsigned endpoint) {
+        return Mix(Mix(Seed(endpoint, TOKEN) ^ token.hi) ^ token.lo);
+    }
+
+    uint64_t RateLimiter::Now(Clock::time_point now) const {
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - start_).count();
+        return static_cast<uint64_t>(std::max<int64_t>(elapsed, 0) / 10) & TIME_MASK;
+    }
+
+    std::optional<std::chrono::milliseconds> RateLimiter::Acquire(uint64_t key, const RateLimit& limit, Clock::time_point now) {
+        if (!(limit.rate > 0))
+            return std::nullopt;
+        const uint64_t time = Now(now);
+        const uint64_t interval = std::max<uint64_t>(1, std::llround(100000.0 / limit.rate));
+        const uint64_t tolerance = interval * (std::max(limit.burst, 1u) - 1);
+        const uint64_t hash = Mix(key ^ seed_);
+        const uint64_t fingerprint = ((hash >> TIME_BITS) | 1) << TIME_BITS;
+        auto& shard = shards_[hash & (SHARDS - 1)];
+
+        for (;;) {
+            std::atomic<uint64_t>* victim = nullptr;
+            uint64_t victim_value = 0;
+            bool found = false;
+            for (auto& slot : shard.slots) {
+                uint64_t value = slot.load(std::memory_order_relaxed);
+                if ((value & ~TIME_MASK) == fingerprint) {
+                    found = true;
+                    while ((value & ~TIME_MASK) == fingerprint) {
+                        uint64_t tat = std::max(value & TIME_MASK, time);
+                        if (tat - time > tolerance)
+                            return std::chrono::milliseconds((tat - time - tolerance + 99) / 100);
+                        if (slot.compare_exchange_weak(value, fingerprint | ((tat + interval) & TIME_MASK), std::memory_order_relaxed))
+                            return std::nullopt;
+                    }
+                    //the slot was swept or taken by another key meanwhile
+                    break;
+                }
+                //an empty slot first, then the fullest bucket; a live bucket of another key is given up only if
+                //the shard is crowded, which lets its client start over with a full bucket
+                if (!victim || (value & TIME_MASK) < (victim_value & TIME_MASK)) {
+                    victim = &slot;
+                    victim_value = value;
+                }
+            }
+            if (found)
+                continue;
+            //a key may get two slots if two threads add it at once; the spare one fills up and is swept
+            if (victim->compare_exchange_strong(victim_value, fingerprint | ((time + interval) & TIME_MASK), std::memory_order_relaxed))
+                return std::nullopt;
+        }
+    }
+
+    void RateLimiter::Sweep(Clock::time_point now) {
+        const uint64_t time = Now(now);
+        for (size_t i = 0; i < SHARDS; ++i) {
+            for (auto& slot : shards_[i].slots) {
+                uint64_t value = slot.load(std::memory_order_relaxed);
+                if (value != 0 && (value & TIME_MASK) <= time)
+                    slot.compare_exchange_strong(value, 0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+}  // namespace http_handler
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+#include <boost/asio/ip/address.hpp>
+
+#include "../app/token_map.h"
+
+namespace http_handler {
+
+    //token bucket: "rate" requests per second on average, up to "burst" of them at once; rate 0 - no limit
+    struct RateLimit {
+        double rate = 0;
+        unsigned burst = 1;
+    };
+
+    //"<name>=<rate>/<burst>" (e.g. "action=20/40") of the command line; std::nullopt if it is malformed
+    std::optional<std::pair<std::string_view, RateLimit>> ParseRateLimit(std::string_view option);
+
+    //token buckets of clients, checked on the io threads. A bucket is one 64-bit word (a fingerprint of its key
+    //and the theoretical arrival time of GCRA, which is a token bucket kept as a single number) updated by
+    //compare-and-swap, so no lock is taken. Buckets are spread over cache-line shards of 8 slots by the
+    //seeded hash of the key; a full bucket is the same as no bucket, so such slots are reused by other keys
+    //and cleared by Sweep
+    class RateLimiter {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        RateLimiter();
+
+        RateLimiter(const RateLimiter&) = delete;
+        RateLimiter& operator=(const RateLimiter&) = delete;
+
+        //keys of a remote address or a token on endpoint "endpoint"
+        static uint64_t Key(const boost::asio::ip::address& address, unsigned endpoint);
+        static uint64_t Key(const app::Token128& token, unsigned endpoint);
+
+        //takes a request from the bucket of "key"; std::nullopt if it may go, otherwise the time until it may
+        std::optional<std::chrono::milliseconds> Acquire(uint64_t key, const RateLimit& limit, Clock::time_point now = Clock::now());
+
+        //clears the slots of full buckets; any thread, e.g. by a timer every few seconds
+        void Sweep(Clock::time_point now = Clock::now());
+
+    private:
+        static constexpr size_t SLOTS_PER_SHARD = 8;
+        static constexpr size_t SHARDS = 16384;      //x 64 bytes
+        static constexpr int TIME_BITS = 44;         //in units of 10 us: 5 years of uptime
+        static constexpr uint64_t TIME_MASK = (uint64_t{ 1 } << TIME_BITS) - 1;
+
+        struct alignas(64) Shard {
+            std::atomic<uint64_t> slots[SLOTS_PER_SHARD];
+        };
+
+        uint64_t Now(Clock::time_point now) const;
+
+        std::unique_ptr<Shard[]> shards_;
+        uint64_t seed_;
+        Clock::time_point start_ = Clock::now();
+    };
+
+}  // namespace http_handler
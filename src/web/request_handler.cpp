@@ -83,67 +83,72 @@ namespace http_handler {
         return val;
     }
 
-    std::string GetMaps(const model::Game& game) {
-        std::vector<MapInfo> maps_info;
-        auto maps = game.GetMaps();
-        for (int i = 0; i < maps.size(); ++i)
-            maps_info.emplace_back(maps[i]);
-        std::string answ = json::serialize(json::value_from(maps_info));
-        return answ;
+    json::value UpgradeRequired() {
+        json::value val = {
+          {"code", "upgradeRequired"},
+          {"message","WebSocket upgrade is expected"} };
+        return val;
     }
-   
-    std::string GetFileType(std::string file_name) {
-        std::string answ;
-        auto it = file_name.rbegin();
-        while (*it != '.' && it !=  file_name.rend()) {
-            *it = std::tolower(*it);
-            answ = *(it++) + answ;
-        }
-        if (answ == "htm" || answ == "html")
-            return "text/html";
-        if (answ == "css")
-            return "text/css";
-        if (answ == "txt")
-            return "text/plain";
-        if (answ == "js")
-            return "text/javascript";
-        if (answ == "json")
-            return "application/json";
-        if (answ == "xml")
-            return "application/xml";
-        if (answ == "png")
-            return "image/png";
-        if (answ == "jpg" || answ == "jpeg" || answ == "jpe")
-            return "image/jpeg";
-        if (answ == "gif")
-            return "image/gif";
-        if (answ == "bmp")
-            return "image/bmp";
-        if (answ == "ico")
-            return "image/vnd.microsoft.icon";
-        if (answ == "tiff" || answ == "tif")
-            return "image/tiff";
-        if (answ == "svg" || answ == "svgz")
-            return "image/svg+xml";
-        if (answ == "mp3")
-            return "audio/mpeg";
-        return "application/octet-stream";
+
+    json::value TileNotFound() {
+        json::value val = {
+          {"code", "tileNotFound"},
+          {"message","Tile not found"} };
+        return val;
     }
 
-    bool IsFileExist(const fs::path& file_path) {
-        return std::filesystem::exists(file_path);
+    json::value TooManyRequests() {
+        json::value val = {
+          {"code", "tooManyRequests"},
+          {"message","Too many requests"} };
+        return val;
     }
 
-    bool IsAccessibleFile(fs::path file_path, fs::path base_path) {
-        file_path = fs::weakly_canonical(file_path);
-        base_path = fs::weakly_canonical(base_path);
+    namespace {
+        struct PrebuiltAnswer {
+            http::status status;
+            std::string_view content_type;
+            http_server::SharedBody::value_type body;
+        };
 
-        for (auto b = base_path.begin(), p = file_path.begin(); b != base_path.end(); ++b, ++p) {
-            if (p == file_path.end() || *p != *b) {
-                return false;
-            }
+        PrebuiltAnswer JsonAnswer(http::status status, const json::value& jv) {
+            return { status, "application/json", std::make_shared<const std::string>(json::serialize(jv)) };
         }
-        return true;
+
+        PrebuiltAnswer TextAnswer(http::status status, std::string_view text) {
+            return { status, "text/plain", std::make_shared<const std::string>(text) };
+        }
+
+        //indexed by Answer; built before main()
+        const std::array<PrebuiltAnswer, static_cast<size_t>(Answer::Count)> PREBUILT_ANSWERS = [] {
+            std::array<PrebuiltAnswer, static_cast<size_t>(Answer::Count)> answers;
+            const auto set = [&answers](Answer answer, PrebuiltAnswer prebuilt) {
+                answers[static_cast<size_t>(answer)] = std::move(prebuilt);
+                };
+            set(Answer::BadRequest, JsonAnswer(http::status::bad_request, BadRequest()));
+            set(Answer::MapNotFound, JsonAnswer(http::status::not_found, MapNotFound()));
+            set(Answer::EmptyNickname, JsonAnswer(http::status::bad_request, EmptyNickname()));
+            set(Answer::JsonParseError, JsonAnswer(http::status::bad_request, JsonParseError()));
+            set(Answer::NotPostRequest, JsonAnswer(http::status::method_not_allowed, NotPostRequest()));
+            set(Answer::AuthorizationMissing, JsonAnswer(http::status::unauthorized, AuthorizationMissing()));
+            set(Answer::PlayerNotFound, JsonAnswer(http::status::unauthorized, PlayerNotFound()));
+            set(Answer::InvalidMethod, JsonAnswer(http::status::method_not_allowed, InvalidMethod()));
+            set(Answer::InvalidContentType, JsonAnswer(http::status::bad_request, InvalidContentType()));
+            set(Answer::ErrorParseAction, JsonAnswer(http::status::bad_request, ErrorParseAction()));
+            set(Answer::ErrorParseTick, JsonAnswer(http::status::bad_request, ErrorParseTick()));
+            set(Answer::EmptyObject, JsonAnswer(http::status::ok, json::object()));
+            set(Answer::FileNotFound, TextAnswer(http::status::not_found, "File not found"));
+            set(Answer::FileNotAccessible, TextAnswer(http::status::bad_request, "Not access"));
+            set(Answer::UpgradeRequired, JsonAnswer(http::status::upgrade_required, UpgradeRequired()));
+            set(Answer::TileNotFound, JsonAnswer(http::status::not_found, TileNotFound()));
+            set(Answer::TooManyRequests, JsonAnswer(http::status::too_many_requests, TooManyRequests()));
+            return answers;
+        }();
+    }
+
+   
+    bool IsFileExist(const fs::path& file_path) {
+        return std::filesystem::exists(file_path);
     }
 
     http::file_body::value_type ReadFile(const fs::path& file_path) {
@@ -155,6 +160,39 @@ namespace http_handler {
         return file;
     }
 
+    std::optional<std::string_view> GetQueryParam(std::string_view query, std::string_view name) {
+        while (!query.empty()) {
+            auto amp = query.find('&');
+            auto param = query.substr(0, amp);
+            query = amp == std::string_view::npos ? std::string_view{} : query.substr(amp + 1);
+            auto eq = param.find('=');
+            if (param.substr(0, eq) == name)
+                return eq == std::string_view::npos ? std::string_view{} : param.substr(eq + 1);
+        }
+        return std::nullopt;
+    }
+
+    std::string RedactQueryParam(std::string_view target, std::string_view name) {
+        auto question = target.find('?');
+        if (question == std::string_view::npos)
+            return std::string(target);
+        std::string redacted(target.substr(0, question + 1));
+        auto query = target.substr(question + 1);
+        while (!query.empty()) {
+            auto amp = query.find('&');
+            auto param = query.substr(0, amp);
+            query = amp == std::string_view::npos ? std::string_view{} : query.substr(amp + 1);
+            auto eq = param.find('=');
+            if (param.substr(0, eq) == name && eq != std::string_view::npos)
+                redacted.append(param.substr(0, eq + 1)).append("***");
+            else
+                redacted.append(param);
+            if (amp != std::string_view::npos)
+                redacted.push_back('&');
+        }
+        return redacted;
+    }
+
     std::string UrlDeCode(const std::string& url_path) {
         std::string answ;
         auto it = url_path.begin();
@@ -178,47 +216,438 @@ namespace http_handler {
         return answ;
     }
 
-    void tag_invoke(boost::json::value_from_tag, boost::json::value& jv, MapInfo const& map_info) {
-        jv = {
-            {"id", *map_info.id_},
-            {"name", map_info.name_}
-        };
+
+    StringResponse RequestHandler::MakeStringResponse(http::status status, std::string_view body, unsigned http_version, bool keep_alive, boost::beast::string_view content_type, std::pmr::memory_resource* resource) {
+        http_server::ArenaAllocator<char> allocator(resource);
+        StringResponse response(std::piecewise_construct, std::make_tuple(body, allocator), std::make_tuple(allocator));
+        response.result(status);
+        response.version(http_version);
+        response.set(http::field::content_type, content_type);
+        response.content_length(body.size());
+        response.keep_alive(keep_alive);
+        return response;
     }
 
+    SharedResponse RequestHandler::MakeSharedResponse(http_server::SharedBody::value_type body, unsigned http_version, bool keep_alive, std::pmr::memory_resource* resource, std::string_view content_type) {
+        auto size = http_server::SharedBody::size(body);
+        SharedResponse response(std::piecewise_construct, std::make_tuple(std::move(body)), std::make_tuple(http_server::ArenaAllocator<char>(resource)));
+        response.result(http::status::ok);
+        response.version(http_version);
+        response.set(http::field::content_type, boost::beast::string_view(content_type.data(), content_type.size()));
+        response.set(http::field::cache_control, "no-cache");
+        response.content_length(size);
+        response.keep_alive(keep_alive);
+        return response;
+    }
 
-    FileResponse RequestHandler::HEADMakeFileResponse(http::status status, fs::path file_path, unsigned http_version, bool keep_alive, std::string content_type) {
-        FileResponse response(status, http_version);
-        response.set(http::field::content_type, content_type);
-        response.content_length(0);
+    http_server::SharedBody::value_type RequestHandler::EncodeState(const model::GameSession& session, model::StateEncoding encoding) {
+        std::string state;
+        if (encoding == model::StateEncoding::Binary) {
+            binary_writer::BinaryWriter writer(state);
+            binary_writer::WriteGameState(writer, session);
+        }
+        else {
+            state.reserve(json_writer::EstimateGameStateSize(session));
+            json_writer::JsonWriter writer(state);
+            json_writer::WriteGameState(writer, session);
+        }
+        return std::make_shared<const std::string>(std::move(state));
+    }
+
+    http_server::SharedBody::value_type RequestHandler::CurrentStateSnapshot(model::GameSession& session, model::StateEncoding encoding) {
+        auto snapshot = session.GetStateSnapshot(encoding);
+        if (!snapshot) {
+            snapshot = EncodeState(session, encoding);
+            session.PublishStateSnapshot(snapshot, encoding);
+        }
+        return snapshot;
+    }
+
+    http_server::SharedBody::value_type RequestHandler::EncodeStateArea(model::GameSession& session, model::Position center, double radius) {
+        auto snapshot = CurrentStateSnapshot(session);
+        auto& cache = state_cells_[&session];
+        if (cache.snapshot != snapshot) {
+            cache.cells = std::make_unique<json_writer::StateCells>(session);
+            cache.snapshot = std::move(snapshot);
+        }
+        std::string state;
+        cache.cells->Write(state, center, radius);
+        return std::make_shared<const std::string>(std::move(state));
+    }
+
+    http_server::SharedBody::value_type RequestHandler::EncodeStateSince(const model::GameSession& session, uint64_t since) {
+        std::string state;
+        state.reserve(json_writer::EstimateGameStateSize(session));
+        json_writer::JsonWriter writer(state);
+        json_writer::WriteGameStateSince(writer, session, since);
+        return std::make_shared<const std::string>(std::move(state));
+    }
+
+    void RequestHandler::PublishStateSnapshots() {
+        bool binary = binary_state_used_.load(std::memory_order_relaxed);
+        for (auto& session : game_.GetGameSessions()) {
+            session->PublishStateSnapshot(EncodeState(*session));
+            session->PublishStateSnapshot(binary ? EncodeState(*session, model::StateEncoding::Binary) : nullptr, model::StateEncoding::Binary);
+        }
+    }
+
+    namespace {
+        //true if a response with "content_type" and a body of "size" bytes is to be compressed into "encoding"
+        template <typename Response>
+        bool ShouldCompress(const Response& response, size_t size, compression::Encoding encoding, int level) {
+            auto content_type = response[http::field::content_type];
+            return encoding != compression::Encoding::Identity && level > 0 && size >= compression::MIN_SIZE
+                && response[http::field::content_encoding].empty() && response[http::field::content_range].empty()
+                && compression::IsCompressible({ content_type.data(), content_type.size() });
+        }
+
+        template <typename Response>
+        void SetContentEncoding(Response& response, compression::Encoding encoding, size_t size) {
+            auto name = compression::Name(encoding);
+            response.set(http::field::content_encoding, boost::beast::string_view(name.data(), name.size()));
+            auto vary = response[http::field::vary];
+            if (vary.find("Accept-Encoding") == boost::beast::string_view::npos)
+                response.set(http::field::vary, vary.empty() ? std::string("Accept-Encoding") : std::string(vary) + ", Accept-Encoding");
+            //another coding is another representation with a validator of its own
+            auto etag = response[http::field::etag];
+            if (!etag.empty())
+                response.set(http::field::etag, CodingEtag({ etag.data(), etag.size() }, name));
+            response.content_length(size);
+        }
+    }
+
+    void RequestHandler::CompressResponse(SharedResponse& response, compression::Encoding encoding) {
+        auto& body = response.body();
+        if (!body || !ShouldCompress(response, body->size(), encoding, compressed_bodies_.GetLevel()))
+            return;
+        body = compressed_bodies_.Get(body, encoding);
+        SetContentEncoding(response, encoding, body->size());
+    }
+
+    void RequestHandler::CompressResponse(StringResponse& response, compression::Encoding encoding) {
+        auto& body = response.body();
+        if (!ShouldCompress(response, body.size(), encoding, compressed_bodies_.GetLevel()))
+            return;
+        auto compressed = compression::Compress({ body.data(), body.size() }, encoding, compressed_bodies_.GetLevel());
+        body.assign(compressed.data(), compressed.size());
+        SetContentEncoding(response, encoding, body.size());
+    }
+
+    void RequestHandler::PushGameSockets() {
+        auto now = std::chrono::steady_clock::now();
+        //sockets of one session that got the same tick share the encoded delta
+        std::map<std::pair<const model::GameSession*, uint64_t>, http_server::SharedBody::value_type> deltas;
+        for (auto it = game_sockets_.begin(); it != game_sockets_.end();) {
+            auto& socket = it->second;
+            bool retired = !tokens_.FindPlayerByToken(socket.token);
+            if (retired || (socket.ws->IsBusy() && now - socket.sent_at > MAX_SOCKET_LAG)) {
+                socket.ws->Drop();   //erased by its on_close
+                ++it;
+                continue;
+            }
+            if (socket.ws->IsBusy()) {
+                ++it;
+                continue;
+            }
+            http_server::SharedBody::value_type frame;
+            if (socket.full)
+                frame = CurrentStateSnapshot(*socket.session);
+            else {
+                auto& delta = deltas[{ socket.session.get(), socket.tick }];
+                if (!delta)
+                    delta = EncodeStateSince(*socket.session, socket.tick);
+                frame = delta;
+            }
+            if (socket.ws->Send(std::move(frame))) {
+                socket.tick = socket.session->GetHistory().GetTick();
+                socket.sent_at = now;
+            }
+            ++it;
+        }
+    }
+
+    void RequestHandler::PushSpectators() {
+        auto now = std::chrono::steady_clock::now();
+        for (auto& [map_id, group] : spectators_) {
+            if (group.sockets.empty())
+                continue;
+            if (!group.session)
+                group.session = game_.FindRunningGameSession(model::Map::Id{ map_id });
+            if (!group.session)
+                continue;
+            auto frame = CurrentStateSnapshot(*group.session);
+            for (auto it = group.sockets.begin(); it != group.sockets.end();) {
+                auto& spectator = it->second;
+                if (!spectator.ws->IsBusy())
+                    spectator.idle_at = now;
+                else if (now - spectator.idle_at > MAX_SOCKET_LAG) {
+                    spectator.ws->Drop();   //erased by its on_close
+                    ++it;
+                    continue;
+                }
+                spectator.ws->Push(frame);
+                ++it;
+            }
+        }
+    }
+
+    bool RequestHandler::TakeSpectatorSlot(const boost::asio::ip::address& remote) {
+        if (remote.is_unspecified())
+            return true;
+        const auto key = RateLimiter::Key(remote, static_cast<unsigned>(Route::Spectate));
+        std::lock_guard lock(spectator_slots_mutex_);
+        auto& open = spectator_slots_[key];
+        if (open >= MAX_SPECTATORS_PER_ADDRESS)
+            return false;
+        ++open;
+        return true;
+    }
+
+    void RequestHandler::ReleaseSpectatorSlot(const boost::asio::ip::address& remote) {
+        if (remote.is_unspecified())
+            return;
+        const auto key = RateLimiter::Key(remote, static_cast<unsigned>(Route::Spectate));
+        std::lock_guard lock(spectator_slots_mutex_);
+        auto it = spectator_slots_.find(key);
+        if (it != spectator_slots_.end() && --it->second == 0)
+            spectator_slots_.erase(it);
+    }
+
+    void RequestHandler::OnSocketFrame(const app::Token128& token, const boost::asio::ip::address& remote, std::string_view frame) {
+        json::error_code ec;
+        json::value jv = json::parse(json::string_view(frame.data(), frame.size()), ec);
+        if (ec || !jv.is_object() || !jv.as_object().contains("move") || !jv.as_object().at("move").is_string())
+            return;   //not a command
+        if (TakeRateLimit(Route::MovePlayer, remote, token))
+            return;   //over the limit; a socket has no way to answer it
+        if (auto player = tokens_.FindPlayerByToken(token))
+            EnqueueMove({ std::move(player), token, std::string(jv.as_object().at("move").as_string()), {} });
+    }
+
+    void RequestHandler::EnqueueMove(MoveCommand command) {
+        move_commands_.Push(std::move(command));
+        if (!IsAutomaticTick && !moves_posted_.exchange(true, std::memory_order_acq_rel)) {
+            boost::asio::post(strand_, [this]() {
+                //cleared by a read-modify-write before the drain. A producer whose exchange still reads "true" is
+                //ordered before this one, so its push is visible to the Pops below; a producer ordered after it
+                //reads "false" and posts a drain of its own. A plain store would give neither guarantee
+                moves_posted_.exchange(false, std::memory_order_acq_rel);
+                ApplyMoves();
+                });
+        }
+    }
+
+    void RequestHandler::ApplyMoves() {
+        while (auto command = move_commands_.Pop()) {
+            auto answer = Answer::EmptyObject;
+            //the player may have retired while the command was queued
+            if (tokens_.FindPlayerByToken(command->token) != command->player)
+                answer = Answer::PlayerNotFound;
+            else if (command->player->Move(command->dir))
+                recorder_.RecordAction(command->token.ToString(), command->dir);
+            else
+                answer = Answer::ErrorParseAction;
+            if (command->done)
+                command->done(answer);
+        }
+    }
+
+    json::value RequestHandler::PlayersToJson(const model::GameSession& session) {
+        json::object players;
+        for (auto& [name, dog] : session.GetDogs())
+            players.emplace(std::to_string(dog->GetId()), json::object{ {"name", dog->GetName()} });
+        return players;
+    }
+
+    RequestHandler::BatchOperation RequestHandler::ParseBatchOperation(const json::value& operation, std::string_view header_token) const {
+        BatchOperation result;
+        auto object = operation.if_object();
+        auto op = object && object->contains("op") ? object->at("op").if_string() : nullptr;
+        if (!op) {
+            result.error = Answer::BadRequest;
+            return result;
+        }
+        if (*op == "action") {
+            result.kind = BatchOperation::Kind::Action;
+            auto move = object->contains("move") ? object->at("move").if_string() : nullptr;
+            if (!move) {
+                result.error = Answer::ErrorParseAction;
+                return result;
+            }
+            result.dir = std::string(*move);
+        }
+        else if (*op == "state") {
+            result.kind = BatchOperation::Kind::State;
+        }
+        else if (*op == "players") {
+            result.kind = BatchOperation::Kind::Players;
+        }
+        else {
+            result.error = Answer::BadRequest;
+            return result;
+        }
+        std::string_view token = header_token;
+        if (object->contains("token")) {
+            auto value = object->at("token").if_string();
+            token = value ? std::string_view(value->data(), value->size()) : std::string_view{};
+        }
+        if (token.empty()) {
+            result.error = Answer::AuthorizationMissing;
+            return result;
+        }
+        auto parsed = app::Token128::Parse(token);
+        result.player = parsed ? tokens_.FindPlayerByToken(*parsed) : nullptr;
+        if (!result.player) {
+            result.error = Answer::PlayerNotFound;
+            return result;
+        }
+        result.token = *parsed;
+        return result;
+    }
+
+    namespace {
+        void AppendBatchResult(std::string& out, http::status status, std::string_view body) {
+            if (out.size() > 1)
+                out += ',';
+            out += "{\"status\":";
+            out += std::to_string(static_cast<unsigned>(status));
+            out += ",\"body\":";
+            out += body;
+            out += '}';
+        }
+
+        void AppendBatchResult(std::string& out, Answer answer) {
+            const auto& prebuilt = PREBUILT_ANSWERS[static_cast<size_t>(answer)];
+            AppendBatchResult(out, prebuilt.status, *prebuilt.body);
+        }
+    }
+
+    std::string RequestHandler::RunBatch(const std::vector<BatchOperation>& operations) {
+        //commands queued before the batch go first, so a batch move is not overridden by an older one
+        //(neither in the game nor in the record)
+        ApplyMoves();
+        std::string out = "[";
+        for (auto& operation : operations) {
+            if (operation.error) {
+                AppendBatchResult(out, *operation.error);
+                continue;
+            }
+            //the player may have retired since the batch was parsed
+            if (tokens_.FindPlayerByToken(operation.token) != operation.player) {
+                AppendBatchResult(out, Answer::PlayerNotFound);
+                continue;
+            }
+            auto& session = *operation.player->GetGameSession();
+            switch (operation.kind) {
+            case BatchOperation::Kind::Action:
+                if (!operation.player->Move(operation.dir)) {
+                    AppendBatchResult(out, Answer::ErrorParseAction);
+                    break;
+                }
+                recorder_.RecordAction(operation.token.ToString(), operation.dir);
+                AppendBatchResult(out, Answer::EmptyObject);
+                break;
+            case BatchOperation::Kind::State:
+                AppendBatchResult(out, http::status::ok, *CurrentStateSnapshot(session));
+                break;
+            case BatchOperation::Kind::Players:
+                AppendBatchResult(out, http::status::ok, json::serialize(PlayersToJson(session)));
+                break;
+            }
+        }
+        out += ']';
+        return out;
+    }
+
+    SharedResponse RequestHandler::MakePrebuiltResponse(Answer answer, unsigned http_version, bool keep_alive, std::pmr::memory_resource* resource, std::string_view allow) {
+        const auto& prebuilt = PREBUILT_ANSWERS[static_cast<size_t>(answer)];
+        SharedResponse response(std::piecewise_construct, std::make_tuple(prebuilt.body), std::make_tuple(http_server::ArenaAllocator<char>(resource)));
+        response.result(prebuilt.status);
+        response.version(http_version);
+        response.set(http::field::content_type, boost::beast::string_view(prebuilt.content_type.data(), prebuilt.content_type.size()));
+        if (prebuilt.content_type == "application/json")
+            response.set(http::field::cache_control, "no-cache");
+        if (!allow.empty())
+            response.set(http::field::allow, boost::beast::string_view(allow.data(), allow.size()));
+        response.content_length(prebuilt.body->size());
+        response.keep_alive(keep_alive);
         return response;
     }
 
-    StringResponse RequestHandler::MakeStringResponse(http::status status, std::string_view body, unsigned http_version, bool keep_alive, boost::beast::string_view content_type) {
-        StringResponse response(status, http_version);
-        response.set(http::field::content_type, content_type);
-        response.body() = body;
+    StringResponse RequestHandler::MakeJsonResponse(http::status status, const json::value& jv, unsigned http_version, bool keep_alive, std::pmr::memory_resource* resource) {
+        StringResponse response = MakeStringResponse(status, {}, http_version, keep_alive, "application/json", resource);
+        auto& body = response.body();
+        json::serializer sr;
+        sr.reset(&jv);
+        while (!sr.done()) {
+            size_t size = body.size();
+            body.resize(std::max<size_t>(2 * size, 256));
+            size_t written = sr.read(body.data() + size, body.size() - size).size();
+            body.resize(size + written);
+        }
         response.content_length(body.size());
-        response.keep_alive(keep_alive);
+        response.set(http::field::cache_control, "no-cache");
         return response;
     }
 
-    FileResponse RequestHandler::GETMakeFileResponse(http::status status, fs::path file_path, unsigned http_version, bool keep_alive, std::string content_type) {
-        FileResponse response(status, http_version);
-        response.set(http::field::content_type, content_type);
-        response.body() = ReadFile(file_path);
-        response.prepare_payload();
+    std::optional<FileRangeResponse> RequestHandler::MakeFileRangeResponse(const fs::path& file_path, ByteRange range, unsigned http_version, bool keep_alive, std::string_view content_type) {
+        FileRangeResponse response(http::status::ok, http_version);
+        boost::system::error_code ec;
+        response.body().file.open(file_path.string().data(), beast::file_mode::read, ec);
+        if (ec)
+            return std::nullopt;
+        response.body().offset = range.first;
+        response.body().length = range.length;
+        response.set(http::field::content_type, boost::beast::string_view(content_type.data(), content_type.size()));
+        response.content_length(range.length);
+        response.keep_alive(keep_alive);
         return response;
     }
 
     void RequestHandler::SetFilePath(fs::path file_path) {
         path_ = file_path;
+        static_files_.Rebuild(path_);
+    }
+
+    void RequestHandler::ReloadStaticFiles() {
+        try {
+            static_files_.Rebuild(path_);
+        }
+        catch (const std::exception& ex) {
+            ServerErrorLog(0, ex.what(), "static files reload");
+        }
     }
 
     void RequestHandler::SetSerializationParams(double is_save, double is_auto_save, double save_interval, std::filesystem::path state_file_path) {
         serializating_listener_.SetParams(is_save, is_auto_save, save_interval, state_file_path);
     }
 
-    bool RequestHandler::CheckAuthorization(const app::Token& tocken) {
-        return static_cast<bool>(tokens_.FindPlayerByToken(tocken));
+    void RequestHandler::SetRateLimit(std::string_view endpoint, RateLimit limit, bool per_address) {
+        for (auto& [name, route] : RATE_LIMITED_ROUTES) {
+            if (name == endpoint) {
+                auto& limits = rate_limits_[static_cast<size_t>(route)];
+                (per_address ? limits.per_address : limits.per_token) = limit;
+                return;
+            }
+        }
+        throw std::invalid_argument("Unknown rate limited endpoint " + std::string(endpoint));
+    }
+
+    std::optional<std::chrono::milliseconds> RequestHandler::TakeRateLimit(Route route, const boost::asio::ip::address& remote, const std::optional<app::Token128>& token) {
+        const auto& limits = rate_limits_[static_cast<size_t>(route)];
+        const auto endpoint = static_cast<unsigned>(route);
+        std::optional<std::chrono::milliseconds> wait;
+        if (limits.per_address.rate > 0 && !remote.is_unspecified())
+            wait = rate_limiter_.Acquire(RateLimiter::Key(remote, endpoint), limits.per_address);
+        if (!wait && limits.per_token.rate > 0 && token)
+            wait = rate_limiter_.Acquire(RateLimiter::Key(*token, endpoint), limits.per_token);
+        return wait;
+    }
+
+    bool RequestHandler::HasRateLimits() const {
+        return std::any_of(rate_limits_.begin(), rate_limits_.end(), [](const RouteRateLimits& limits) {
+            return limits.per_token.rate > 0 || limits.per_address.rate > 0;
+            });
     }
+
 }   // namespace http_handler
@@ -3,14 +3,32 @@
 #include <ctime>
 #include <variant>
 #include <iostream>
+#include <array>
+#include <optional>
+#include <string_view>
+#include <charconv>
+#include <cmath>
+#include <unordered_set>
+#include <mutex>
 
 #include <boost/asio/strand.hpp>
 #include "boost/json.hpp"
 
 #include "../model/model.h"
+#include "../json_tools/json_writer.h"
+#include "../json_tools/state_cells.h"
+#include "../binary_tools/binary_writer.h"
 #include "http_server.h"
+#include "shared_body.h"
+#include "state_waiters.h"
+#include "compression.h"
+#include "static_files.h"
+#include "file_types.h"
+#include "map_responses.h"
+#include "rate_limiter.h"
 #include "log.h"
 #include "../app/app.h"
+#include "../app/mpsc_queue.h"
 #include "../extra/extra_data.h"
 #include "../serialization/app_serialization.h"
 #include "../database_tools/postgres.h"
@@ -23,8 +41,10 @@ namespace http_handler {
     namespace fs = std::filesystem;
 
     using StringRequest = http::request<http::string_body>;
-    using StringResponse = http::response<http::string_body>;
-    using FileResponse = http::response<http::file_body>;
+    //responses are built in the arena of the connection (see http_server::SessionArena)
+    using StringResponse = http::response<http::basic_string_body<char, std::char_traits<char>, http_server::ArenaAllocator<char>>, http::basic_fields<http_server::ArenaAllocator<char>>>;
+    using SharedResponse = http::response<http_server::SharedBody, http::basic_fields<http_server::ArenaAllocator<char>>>;
+    using FileRangeResponse = http::response<http_server::FileRangeBody>;
 
     //json answers
     json::value BadRequest();
@@ -38,57 +58,240 @@ namespace http_handler {
     json::value InvalidContentType(); 
     json::value ErrorParseAction();
     json::value ErrorParseTick();
+    json::value UpgradeRequired();
+    json::value TileNotFound();
+    json::value TooManyRequests();
+
+    //constant answers; their responses are serialized once at startup and shared by all connections
+    enum class Answer {
+        BadRequest,
+        MapNotFound,
+        EmptyNickname,
+        JsonParseError,
+        NotPostRequest,
+        AuthorizationMissing,
+        PlayerNotFound,
+        InvalidMethod,
+        InvalidContentType,
+        ErrorParseAction,
+        ErrorParseTick,
+        EmptyObject,         //"{}" of successful actions
+        FileNotFound,
+        FileNotAccessible,
+        UpgradeRequired,     //plain request to the websocket endpoint
+        TileNotFound,
+        TooManyRequests,     //429 of the rate limits; "Retry-After" is added per request
+        Count
+    };
 
-    std::string GetMaps(const model::Game& game);
 
 
     
-    std::string GetFileType(std::string file_name);
     bool IsFileExist(const fs::path& file_path);
-    bool IsAccessibleFile(fs::path file_path, fs::path base_path);
     http::file_body::value_type ReadFile(const fs::path& file_path);
 
     std::string UrlDeCode(const std::string& url_path);
 
-    struct MapInfo {
-        model::Map::Id id_;
-        std::string name_;
-        MapInfo(const model::Map& map):id_(map.GetId()), name_(map.GetName()) {
-        }
-    };
 
     struct Endpoints {
-        static std::string API_Maps_Endpoint() {
+        static constexpr std::string_view API_MapsList_Endpoint() {
+            return "/api/v1/maps";
+        }
+        static constexpr std::string_view API_Maps_Endpoint() {
             return "/api/v1/maps/";
         }
-        static std::string API_AuthGame_Endpoint() {
+        static constexpr std::string_view API_AuthGame_Endpoint() {
             return "/api/v1/game/join";
         }
-        static std::string API_PlayersList_Endpoint() {
+        static constexpr std::string_view API_PlayersList_Endpoint() {
             return "/api/v1/game/players";
         }
-        static std::string API_GameState_Endpoint() {
+        static constexpr std::string_view API_GameState_Endpoint() {
             return "/api/v1/game/state";
         }
-        static std::string API_MovePlayer_Endpoint() {
+        static constexpr std::string_view API_MovePlayer_Endpoint() {
             return "/api/v1/game/player/action";
         }
-        static std::string API_TimeTick_Endpoint() {
+        static constexpr std::string_view API_TimeTick_Endpoint() {
             return "/api/v1/game/tick";
         }
-        static std::string API_GetRecords_Endpoint() {
+        static constexpr std::string_view API_GetRecords_Endpoint() {
             return "/api/v1/game/records";
         }
+        static constexpr std::string_view API_MapTiles_Suffix() {
+            return "/tiles";
+        }
+        static constexpr std::string_view API_Batch_Endpoint() {
+            return "/api/v1/game/batch";
+        }
+        static constexpr std::string_view API_GameSocket_Endpoint() {
+            return "/api/v1/game/socket";
+        }
+        static constexpr std::string_view API_Spectate_Endpoint() {
+            return "/api/v1/game/spectate";
+        }
+    };
+
+    enum class Route {
+        MapsList,
+        Map,
+        MapTile,
+        AuthGame,
+        PlayersList,
+        GameState,
+        MovePlayer,
+        Batch,
+        TimeTick,
+        GetRecords,
+        GameSocket,
+        Spectate,
+        StaticFile
+    };
+
+    //route table built at compile time from Endpoints: exact paths are found through a perfect hash,
+    //so a request is routed by one lookup without allocations
+    namespace routing {
+        constexpr uint64_t Methods(std::initializer_list<http::verb> verbs) {
+            uint64_t mask = 0;
+            for (auto verb : verbs)
+                mask |= uint64_t{ 1 } << static_cast<unsigned>(verb);
+            return mask;
+        }
+
+        constexpr bool IsAllowed(uint64_t methods, http::verb verb) {
+            return static_cast<unsigned>(verb) < 64 && (methods >> static_cast<unsigned>(verb)) & 1;
+        }
+
+        struct RouteEntry {
+            std::string_view path;
+            Route route;
+            uint64_t methods;
+            std::string_view allow;          //"Allow" header of 405 answer
+            std::optional<Answer> method_error; //body of 405 answer; std::nullopt - answer "Bad request" instead
+        };
+
+        constexpr RouteEntry EXACT_ROUTES[] = {
+            { Endpoints::API_MapsList_Endpoint(), Route::MapsList, Methods({ http::verb::get }), "GET", Answer::InvalidMethod },
+            { Endpoints::API_AuthGame_Endpoint(), Route::AuthGame, Methods({ http::verb::post }), "POST", Answer::NotPostRequest },
+            { Endpoints::API_PlayersList_Endpoint(), Route::PlayersList, Methods({ http::verb::get, http::verb::head }), "GET, HEAD", Answer::InvalidMethod },
+            { Endpoints::API_GameState_Endpoint(), Route::GameState, Methods({ http::verb::get, http::verb::head }), "GET, HEAD", Answer::InvalidMethod },
+            { Endpoints::API_MovePlayer_Endpoint(), Route::MovePlayer, Methods({ http::verb::post }), "POST", Answer::NotPostRequest },
+            { Endpoints::API_Batch_Endpoint(), Route::Batch, Methods({ http::verb::post }), "POST", Answer::NotPostRequest },
+            { Endpoints::API_TimeTick_Endpoint(), Route::TimeTick, Methods({ http::verb::post }), "POST", Answer::NotPostRequest },
+            { Endpoints::API_GetRecords_Endpoint(), Route::GetRecords, Methods({ http::verb::get }), "GET", Answer::NotPostRequest },
+            { Endpoints::API_GameSocket_Endpoint(), Route::GameSocket, Methods({ http::verb::get }), "GET", Answer::InvalidMethod },
+            { Endpoints::API_Spectate_Endpoint(), Route::Spectate, Methods({ http::verb::get }), "GET", Answer::InvalidMethod }
+        };
+
+        //"/api/v1/maps/{id}"
+        constexpr RouteEntry MAP_ROUTE = { Endpoints::API_Maps_Endpoint(), Route::Map, Methods({ http::verb::get, http::verb::head }), "GET, HEAD", Answer::InvalidMethod };
+
+        //"/api/v1/maps/{id}/tiles" and "/api/v1/maps/{id}/tiles/{z}/{x}/{y}"
+        constexpr RouteEntry MAP_TILE_ROUTE = { Endpoints::API_Maps_Endpoint(), Route::MapTile, Methods({ http::verb::get, http::verb::head }), "GET, HEAD", Answer::InvalidMethod };
+
+        //everything outside "/api"
+        constexpr RouteEntry STATIC_FILE_ROUTE = { "/", Route::StaticFile, Methods({ http::verb::get, http::verb::head }), "GET, HEAD", std::nullopt };
+
+        constexpr uint32_t Hash(std::string_view str, uint32_t seed) {
+            uint32_t hash = 2166136261u ^ seed;
+            for (char c : str) {
+                hash ^= static_cast<unsigned char>(c);
+                hash *= 16777619u;
+            }
+            return hash;
+        }
+
+        constexpr size_t TABLE_SIZE = 16;
+
+        //the first seed that gives every exact route its own slot
+        constexpr uint32_t SEED = [] {
+            for (uint32_t seed = 0;; ++seed) {
+                bool used[TABLE_SIZE]{};
+                bool is_perfect = true;
+                for (auto& entry : EXACT_ROUTES) {
+                    auto slot = Hash(entry.path, seed) % TABLE_SIZE;
+                    is_perfect = is_perfect && !used[slot];
+                    used[slot] = true;
+                }
+                if (is_perfect)
+                    return seed;
+            }
+        }();
+
+        //slot -> index in EXACT_ROUTES, -1 for empty slots
+        constexpr std::array<int8_t, TABLE_SIZE> TABLE = [] {
+            std::array<int8_t, TABLE_SIZE> table{};
+            table.fill(-1);
+            for (size_t i = 0; i < std::size(EXACT_ROUTES); ++i)
+                table[Hash(EXACT_ROUTES[i].path, SEED) % TABLE_SIZE] = static_cast<int8_t>(i);
+            return table;
+        }();
+    }
+
+    struct RouteMatch {
+        const routing::RouteEntry* entry = nullptr; //nullptr - unknown target
+        std::string_view path;                      //target without query string
+        std::string_view query;                     //after '?', empty if there is none
+        std::string_view map_id;                    //Route::Map and Route::MapTile only
+        std::string_view tile;                      //Route::MapTile only: "/{z}/{x}/{y}", empty for the tile grid
     };
 
+    constexpr RouteMatch MatchRoute(std::string_view target) {
+        RouteMatch match;
+        auto question = target.find('?');
+        match.path = target.substr(0, question);
+        if (question != std::string_view::npos)
+            match.query = target.substr(question + 1);
+
+        if (match.path.starts_with(Endpoints::API_Maps_Endpoint())) {
+            match.entry = &routing::MAP_ROUTE;
+            match.map_id = match.path.substr(Endpoints::API_Maps_Endpoint().size());
+            auto tiles = match.map_id.find(Endpoints::API_MapTiles_Suffix());
+            if (tiles != std::string_view::npos) {
+                auto tile = match.map_id.substr(tiles + Endpoints::API_MapTiles_Suffix().size());
+                if (tile.empty() || tile.front() == '/') {
+                    match.entry = &routing::MAP_TILE_ROUTE;
+                    match.tile = tile;
+                    match.map_id = match.map_id.substr(0, tiles);
+                }
+            }
+            return match;
+        }
+        auto index = routing::TABLE[routing::Hash(match.path, routing::SEED) % routing::TABLE_SIZE];
+        if (index >= 0 && routing::EXACT_ROUTES[index].path == match.path) {
+            match.entry = &routing::EXACT_ROUTES[index];
+            return match;
+        }
+        if (!match.path.starts_with("/api") && match.path != "/favicon.ico")
+            match.entry = &routing::STATIC_FILE_ROUTE;
+        return match;
+    }
+
+    static_assert(MatchRoute("/api/v1/game/state").entry->route == Route::GameState);
+    static_assert(MatchRoute("/api/v1/game/records?start=0&maxItems=10").entry->route == Route::GetRecords);
+    static_assert(MatchRoute("/api/v1/maps/map1").map_id == "map1");
+    static_assert(MatchRoute("/api/v1/maps/map1/tiles/2/1/3").map_id == "map1");
+    static_assert(MatchRoute("/api/v1/maps/map1/tiles/2/1/3").tile == "/2/1/3");
+    static_assert(MatchRoute("/api/v1/maps/map1/tiles").entry->route == Route::MapTile);
+    static_assert(MatchRoute("/api/v1/game/socket?mode=full").entry->route == Route::GameSocket);
+    static_assert(MatchRoute("/api/v1/game/batch").entry->route == Route::Batch);
+    static_assert(MatchRoute("/api/v1/game/unknown").entry == nullptr);
+
+    //value of "name" in query string "a=1&b=2"; std::nullopt if there is no such parameter
+    std::optional<std::string_view> GetQueryParam(std::string_view query, std::string_view name);
+
+    //"target" with the value of query parameter "name" replaced by "***", e.g. to keep tokens out of the log
+    std::string RedactQueryParam(std::string_view target, std::string_view name);
+
     class RequestHandler {
     public:
         using Strand = boost::asio::strand<boost::asio::io_context::executor_type>;
 
         explicit RequestHandler(model::Game& game, extra_data::Json_data& lost_objects_json_data, Strand& strand, postgres_tools::PostgresDatabase& database)
-            : game_{ game }, lost_objects_json_data_(lost_objects_json_data), strand_{ strand },
+            : game_{ game }, lost_objects_json_data_(lost_objects_json_data), map_responses_{ game_, lost_objects_json_data_ }, strand_{ strand },
             serializating_listener_{ players_, game_, tokens_ }, database_{ database },
-            game_timer_{ players_, tokens_, game_.GetGameSessions(), strand_, serializating_listener_, database_ }{
+            game_timer_{ players_, tokens_, game_.GetGameSessions(), strand_, serializating_listener_, &database_, recorder_ },
+            state_waiters_{ strand_ }{
 
         }
         
@@ -96,598 +299,908 @@ namespace http_handler {
 
         RequestHandler& operator=(const RequestHandler&) = delete;
 
-        StringResponse MakeStringResponse(http::status status, std::string_view body, unsigned http_version, bool keep_alive, boost::beast::string_view content_type);
+        StringResponse MakeStringResponse(http::status status, std::string_view body, unsigned http_version, bool keep_alive, boost::beast::string_view content_type, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+        SharedResponse MakePrebuiltResponse(Answer answer, unsigned http_version, bool keep_alive, std::pmr::memory_resource* resource, std::string_view allow = {});
+
+        template <typename Body, typename Allocator>
+        SharedResponse MakePrebuiltResponse(const http::request<Body, http::basic_fields<Allocator>>& req, Answer answer, std::string_view allow = {}) {
+            return MakePrebuiltResponse(answer, req.version(), req.keep_alive(), http_server::ResourceOf(req.get_allocator()), allow);
+        }
+
+        //"200 OK" with an already encoded body (e.g. a state snapshot)
+        SharedResponse MakeSharedResponse(http_server::SharedBody::value_type body, unsigned http_version, bool keep_alive, std::pmr::memory_resource* resource, std::string_view content_type);
+
+        template <typename Body, typename Allocator>
+        SharedResponse MakeSharedResponse(const http::request<Body, http::basic_fields<Allocator>>& req, http_server::SharedBody::value_type body, std::string_view content_type = "application/json") {
+            return MakeSharedResponse(std::move(body), req.version(), req.keep_alive(), http_server::ResourceOf(req.get_allocator()), content_type);
+        }
+
+        //true if the client takes the binary answers of binary_writer; json stays the default
+        template <typename Body, typename Allocator>
+        static bool AcceptsBinary(const http::request<Body, http::basic_fields<Allocator>>& req) {
+            return HeaderValue(req, http::field::accept).find(binary_writer::CONTENT_TYPE) != std::string_view::npos;
+        }
+
+        static std::string_view ContentType(model::StateEncoding encoding) {
+            return encoding == model::StateEncoding::Binary ? binary_writer::CONTENT_TYPE : "application/json";
+        }
+
+        //answer of /api/v1/game/state for "session"; called on the strand
+        static http_server::SharedBody::value_type EncodeState(const model::GameSession& session, model::StateEncoding encoding = model::StateEncoding::Json);
+
+        //snapshot of "session", encoded again if a change has made it stale; called on the strand
+        static http_server::SharedBody::value_type CurrentStateSnapshot(model::GameSession& session, model::StateEncoding encoding = model::StateEncoding::Json);
+
+        //json of /api/v1/game/state?radius=<r> for a dog at "center"; built from the cells of the current
+        //snapshot, which are encoded once for all players of the session. Called on the strand
+        http_server::SharedBody::value_type EncodeStateArea(model::GameSession& session, model::Position center, double radius);
+
+        //json of /api/v1/game/state?since=<tick> for "session"; called on the strand
+        static http_server::SharedBody::value_type EncodeStateSince(const model::GameSession& session, uint64_t since);
+
+        //every session gets the snapshot of its state after the tick (the binary one only once a client has asked for it)
+        void PublishStateSnapshots();
 
-        FileResponse GETMakeFileResponse(http::status status, fs::path file_path, unsigned http_version, bool keep_alive, std::string content_type);
+        //sends the state of the tick to every game socket that is not still writing the previous one;
+        //a socket that has not finished a frame for MAX_SOCKET_LAG is dropped. Called on the strand
+        void PushGameSockets();
 
-        FileResponse HEADMakeFileResponse(http::status status, fs::path file_path, unsigned http_version, bool keep_alive, std::string content_type);
+        //the snapshot of the tick, encoded once per session, goes to all its spectators; a spectator that
+        //has not finished a frame for MAX_SOCKET_LAG is dropped. Called on the strand
+        void PushSpectators();
 
+        //counts an open spectator socket of "remote"; false if the address already has MAX_SPECTATORS_PER_ADDRESS.
+        //An unspecified address is not counted. Any thread
+        bool TakeSpectatorSlot(const boost::asio::ip::address& remote);
+        void ReleaseSpectatorSlot(const boost::asio::ip::address& remote);
+
+        //frame of a game socket from "remote"; called on the executor of the connection. A move counts against
+        //the limits of /api/v1/game/player/action and is dropped over them
+        void OnSocketFrame(const app::Token128& token, const boost::asio::ip::address& remote, std::string_view frame);
+
+        //"move" of a player, made on an io thread and applied by the simulation (see EnqueueMove)
+        struct MoveCommand {
+            std::shared_ptr<app::Player> player;
+            app::Token128 token;
+            std::string dir;
+            std::function<void(Answer)> done;    //EmptyObject, ErrorParseAction or PlayerNotFound; may be empty
+        };
+
+        //any thread. With the automatic tick commands wait for the next tick; otherwise one drain per batch is
+        //posted to the strand
+        void EnqueueMove(MoveCommand command);
+
+        //applies the queued commands in the order they came; on the strand
+        void ApplyMoves();
+
+        static json::value PlayersToJson(const model::GameSession& session);
+
+        //sub-operation of /api/v1/game/batch, parsed and authorized on an io thread
+        struct BatchOperation {
+            enum class Kind {
+                Action,
+                State,
+                Players
+            };
+            Kind kind = Kind::State;
+            std::optional<Answer> error;             //answered as it is, without running the operation
+            std::shared_ptr<app::Player> player;
+            app::Token128 token;
+            std::string dir;                         //Kind::Action only
+
+            //endpoint whose rate limits the operation counts against
+            static Route RouteOf(Kind kind) {
+                return kind == Kind::Action ? Route::MovePlayer : kind == Kind::State ? Route::GameState : Route::PlayersList;
+            }
+        };
+
+        static constexpr size_t MAX_BATCH_SIZE = 256;
+
+        //one operation of the "operations" array, with "header_token" (may be empty) for the ones without "token"
+        BatchOperation ParseBatchOperation(const json::value& operation, std::string_view header_token) const;
+
+        //applies the queued moves, then runs "operations" in order and returns the json array of their results; on the strand
+        std::string RunBatch(const std::vector<BatchOperation>& operations);
+
+        //compresses the body into "encoding" unless it is small or not compressible. A shared body (e.g. a state
+        //snapshot) is compressed once for all responses that send it (see compression::SharedBodyCache)
+        void CompressResponse(SharedResponse& response, compression::Encoding encoding);
+
+        void CompressResponse(StringResponse& response, compression::Encoding encoding);
+
+        //file bodies are sent as they are
+        template <typename Response>
+        void CompressResponse(Response&, compression::Encoding) {
+        }
+
+        //0 turns compression off
+        void SetCompressionLevel(int level) {
+            compressed_bodies_.SetLevel(level);
+        }
+
+        //serializes "jv" straight into the response body
+        StringResponse MakeJsonResponse(http::status status, const json::value& jv, unsigned http_version, bool keep_alive, std::pmr::memory_resource* resource);
+
+        template <typename Body, typename Allocator>
+        StringResponse MakeJsonResponse(const http::request<Body, http::basic_fields<Allocator>>& req, const json::value& jv, http::status status) {
+            return MakeJsonResponse(status, jv, req.version(), req.keep_alive(), http_server::ResourceOf(req.get_allocator()));
+        }
+
+        template <typename Body, typename Allocator>
+        static json::storage_ptr JsonStorage(const http::request<Body, http::basic_fields<Allocator>>& req) {
+            return http_server::SessionArena::JsonStorage(http_server::ResourceOf(req.get_allocator()));
+        }
+
+        //"range" of "file_path"; std::nullopt if the file cannot be opened
+        std::optional<FileRangeResponse> MakeFileRangeResponse(const fs::path& file_path, ByteRange range, unsigned http_version, bool keep_alive, std::string_view content_type);
+
+        //answer without a body, e.g. 304
+        template <typename Body, typename Allocator>
+        static SharedResponse MakeEmptyResponse(const http::request<Body, http::basic_fields<Allocator>>& req, http::status status) {
+            SharedResponse response(std::piecewise_construct, std::make_tuple(), std::make_tuple(http_server::ArenaAllocator<char>(http_server::ResourceOf(req.get_allocator()))));
+            response.result(status);
+            response.version(req.version());
+            response.keep_alive(req.keep_alive());
+            return response;
+        }
+
+        //builds the static file table of "file_path"
         void SetFilePath(fs::path file_path);
 
+        //rereads the static file table (e.g. on SIGHUP); the old one is kept if this fails
+        void ReloadStaticFiles();
+
+        void SetStaticCacheControl(std::string cache_control) {
+            static_cache_control_ = std::move(cache_control);
+        }
+
         void SetSerializationParams(double is_save, double is_auto_save, double save_interval, std::filesystem::path state_file_path);
 
-        bool CheckAuthorization(const app::Token& tocken);
+        //limit of requests to endpoint "endpoint" ("join", "players", "state", "action", "batch", "tick" or
+        //"records") per token or, with "per_address", per remote address; throws std::invalid_argument on an
+        //unknown name
+        void SetRateLimit(std::string_view endpoint, RateLimit limit, bool per_address);
 
-        template <typename Body, typename Allocator, typename Send, typename Fn >
-        void API_PerfomActionWithToken(const http::request<Body, http::basic_fields<Allocator>>& req, Send& send, Fn&& func) {
-            const auto json_text_response = [&req, this](json::value&& jv, http::status status) {
-                std::string answ = json::serialize(jv);
-                StringResponse response = MakeStringResponse(status, answ, req.version(), req.keep_alive(), "application/json");
-                response.set(http::field::cache_control, "no-cache");
-                return response;
-                };
-            auto auth = req.base()["Authorization"].to_string();
-            try {
-                if (auth.substr(7).size() != 32)
-                    throw std::exception();
-            }
-            catch (...) {
-                auto response = json_text_response(AuthorizationMissing(), http::status::unauthorized);
+        bool HasRateLimits() const;
+
+        //forgets the buckets that have filled up again; any thread
+        void SweepRateLimits() {
+            rate_limiter_.Sweep();
+        }
+
+        //token of the "Authorization" header; std::nullopt if the header is missing or malformed
+        template <typename Body, typename Allocator>
+        static std::optional<std::string_view> AuthToken(const http::request<Body, http::basic_fields<Allocator>>& req) {
+            auto auth = HeaderValue(req, http::field::authorization);
+            if (auth.size() != 7 + 32)
+                return std::nullopt;
+            return auth.substr(7);
+        }
+
+        //header value as a view into the request; empty if there is no such header
+        template <typename Body, typename Allocator>
+        static std::string_view HeaderValue(const http::request<Body, http::basic_fields<Allocator>>& req, http::field field) {
+            auto value = req[field];
+            return { value.data(), value.size() };
+        }
+
+        //takes a request to "route" from the buckets of "remote" (unless it is unspecified) and "token" (if any);
+        //std::nullopt if it may go, otherwise the time until it may. Any thread
+        std::optional<std::chrono::milliseconds> TakeRateLimit(Route route, const boost::asio::ip::address& remote, const std::optional<app::Token128>& token);
+
+        //takes "req" from the buckets of its remote address and its token on the calling io thread, so a client
+        //over the limit never gets to the strand; false if the request is answered with 429 then
+        template <typename Body, typename Allocator, typename Send>
+        bool CheckRateLimit(const http::request<Body, http::basic_fields<Allocator>>& req, Send& send, Route route, const boost::asio::ip::address& remote) {
+            //a malformed token is not counted here; it is refused later anyway
+            auto auth = AuthToken(req);
+            auto wait = TakeRateLimit(route, remote, auth ? app::Token128::Parse(*auth) : std::nullopt);
+            if (!wait)
+                return true;
+            auto response = MakePrebuiltResponse(req, Answer::TooManyRequests);
+            auto seconds = std::max<int64_t>(1, (wait->count() + 999) / 1000);
+            char retry_after[24];
+            auto [end, ec] = std::to_chars(std::begin(retry_after), std::end(retry_after), seconds);
+            response.set(http::field::retry_after, beast::string_view(retry_after, end - retry_after));
+            send(response);
+            return false;
+        }
+
+        //player of the token of "req", looked up on the calling thread; nullptr if the token is missing or
+        //unknown, the request is answered then
+        template <typename Body, typename Allocator, typename Send>
+        std::shared_ptr<app::Player> FindRequestPlayer(const http::request<Body, http::basic_fields<Allocator>>& req, Send& send, app::Token128& token) {
+            auto auth = AuthToken(req);
+            if (!auth) {
+                auto response = MakePrebuiltResponse(req, Answer::AuthorizationMissing);
                 send(response);
-                return;
+                return nullptr;
             }
-            auto token_from_req = auth.substr(7);
-            if (CheckAuthorization(token_from_req)) {
-                auto answer = func(token_from_req);
-                if (answer == ErrorParseAction()){
-                    auto response = json_text_response(std::move(answer), http::status::bad_request);
-                    send(response);
-                    return;
-                }
-               auto response = json_text_response(std::move(answer), http::status::ok);
-               send(response);
-               return;
-            }
-            else {
-                auto response = json_text_response(PlayerNotFound(), http::status::unauthorized);
+            auto parsed = app::Token128::Parse(*auth);
+            auto player = parsed ? tokens_.FindPlayerByToken(*parsed) : nullptr;
+            if (!player) {
+                auto response = MakePrebuiltResponse(req, Answer::PlayerNotFound);
                 send(response);
-                return;
+                return nullptr;
             }
+            token = *parsed;
+            return player;
         }
 
-
-        template <typename Body, typename Allocator, typename Send>
-        void GetAPI_info_RequestHand(const http::request<Body, http::basic_fields<Allocator>>& req, Send& send) {
-            const auto text_response = [&req, this](http::status status, std::string_view text, boost::beast::string_view content_type) {
-               auto response  = this->MakeStringResponse(status, text, req.version(), req.keep_alive(), content_type);
-               response.set(http::field::cache_control, "no-cache");
-               return response;
-                };
-            const auto json_text_response = [&req, this](json::value&& jv, http::status status) {
-                std::string answ = json::serialize(jv);
-                StringResponse response = MakeStringResponse(status, answ, req.version(), req.keep_alive(), "application/json");
-                response.set(http::field::cache_control, "no-cache");
-                return response;
-                };
-            if ((req.method_string() == "GET") &&
-                (static_cast<std::string>(req.target()) == "/api/v1/maps"))
-            {
-                std::string answ = GetMaps(game_);
-                auto response = text_response(http::status::ok, answ, "application/json");
-                send(response);
-                return;
-            }
-            if ((req.method_string() == "GET" || req.method_string() == "HEAD") &&
-                (static_cast<std::string>(req.target()).substr(0, 13) == Endpoints::API_Maps_Endpoint()))
-            {
-                std::string id = static_cast<std::string>(req.target()).substr(13); //getting number of map
-                auto map = game_.FindMap(model::Map::Id(id)); //looking for map
-                if (map) {
-                    //std::string answ = json::serialize(json::value_from(*map));
-                    std::string answ = json::serialize(json::value_from(std::pair<model::Map, boost::json::array>(*map, lost_objects_json_data_.Get(id))));
-                    auto response = text_response(http::status::ok, answ, "application/json");
+        //the token is checked on the calling io thread, so a request with a missing or unknown token never
+        //gets to the strand. "func(req, player, token)" runs on the strand and returns the answer
+        template <typename Body, typename Allocator, typename Send, typename Fn >
+        void API_PerfomActionWithToken(http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send, Fn&& func) {
+            app::Token128 token;
+            auto player = FindRequestPlayer(req, send, token);
+            if (!player)
+                return;
+            boost::asio::dispatch(strand_, [send = std::forward<Send>(send), this, req = std::move(req), func = std::forward<Fn>(func), player = std::move(player), token]() mutable {
+                //the player may have retired while the request was on its way
+                if (tokens_.FindPlayerByToken(token) != player) {
+                    auto response = MakePrebuiltResponse(req, Answer::PlayerNotFound);
                     send(response);
                     return;
                 }
+                auto answer = func(req, *player, token);
+                if constexpr (std::is_same_v<decltype(answer), Answer>) {
+                    auto response = MakePrebuiltResponse(req, answer);
+                    send(response);
+                }
+                else if constexpr (std::is_same_v<decltype(answer), StringResponse>) {
+                    send(answer);
+                }
                 else {
-                    std::string answ = json::serialize(MapNotFound());  //map was not found
-                    auto response = text_response(http::status::not_found, answ, "application/json");
+                    auto response = MakeJsonResponse(req, answer, http::status::ok);
                     send(response);
-                    return;
                 }
-            }
+                });
+        }
+
+
+        template <typename Body, typename Allocator, typename Send>
+        void API_MapsList_RequestHand(const http::request<Body, http::basic_fields<Allocator>>& req, Send& send) {
+            auto response = MakeAssetResponse(req, map_responses_.GetList(), "no-cache");
+            send(response);
+        }
 
-            if ((static_cast<std::string>(req.target()).substr(0, 13) == Endpoints::API_Maps_Endpoint())) {
-                auto response = json_text_response(InvalidMethod(), http::status::method_not_allowed);
-                response.set(http::field::allow, "GET, HEAD");
+        template <typename Body, typename Allocator, typename Send>
+        void API_Map_RequestHand(const http::request<Body, http::basic_fields<Allocator>>& req, Send& send, std::string_view map_id) {
+            auto map = map_responses_.Find(map_id);
+            if (!map) {
+                auto response = MakePrebuiltResponse(req, Answer::MapNotFound);  //map was not found
                 send(response);
                 return;
             }
-            return;
+            auto response = MakeAssetResponse(req, AcceptsBinary(req) ? map->binary : map->json, "no-cache", "Accept");
+            send(response);
         }
 
+        //"tile" is "/{z}/{x}/{y}", or empty for the tile grid of the map
         template <typename Body, typename Allocator, typename Send>
-        bool GetStaticFile_RequestHand(const http::request<Body, http::basic_fields<Allocator>>& req, Send& send) {
-            const auto text_response = [&req, this](http::status status, std::string_view text, boost::beast::string_view content_type) {
-                return this->MakeStringResponse(status, text, req.version(), req.keep_alive(), content_type);
+        void API_MapTile_RequestHand(const http::request<Body, http::basic_fields<Allocator>>& req, Send& send, std::string_view map_id, std::string_view tile) {
+            auto map = map_responses_.Find(map_id);
+            if (!map) {
+                auto response = MakePrebuiltResponse(req, Answer::MapNotFound);
+                send(response);
+                return;
+            }
+            if (tile.empty()) {
+                auto response = MakeAssetResponse(req, map->tiles.GetGrid(), "no-cache");
+                send(response);
+                return;
+            }
+            unsigned z = 0;
+            uint64_t x = 0;
+            uint64_t y = 0;
+            const char* end = tile.data() + tile.size();
+            auto parse = [end](const char* from, auto& value) -> const char* {
+                if (from == end || *from != '/')
+                    return nullptr;
+                auto [ptr, ec] = std::from_chars(from + 1, end, value);
+                return ec == std::errc{} ? ptr : nullptr;
                 };
-            const auto get_file_response = [&req, this](http::status status, fs::path file_path, std::string content_type) {
-                return this->GETMakeFileResponse(status, file_path, req.version(), req.keep_alive(), content_type);
+            const char* pos = parse(tile.data(), z);
+            pos = pos ? parse(pos, x) : nullptr;
+            pos = pos ? parse(pos, y) : nullptr;
+            if (pos != end) {
+                auto response = MakePrebuiltResponse(req, Answer::BadRequest);
+                send(response);
+                return;
+            }
+            auto asset = map->tiles.Find(z, x, y);
+            if (!asset) {
+                auto response = MakePrebuiltResponse(req, Answer::TileNotFound);
+                send(response);
+                return;
+            }
+            auto response = MakeAssetResponse(req, *asset, "no-cache");
+            send(response);
+        }
+
+        //answer with the whole "asset": the gzip copy if the client takes it, 304 if the client has the chosen form
+        //("If-None-Match"). "vary" lists the request headers other than "Accept-Encoding" the choice of the asset depends on
+        template <typename Body, typename Allocator>
+        SharedResponse MakeAssetResponse(const http::request<Body, http::basic_fields<Allocator>>& req, const StaticAsset& asset, std::string_view cache_control, std::string_view vary = {}) {
+            const auto encoding = compression::Negotiate(HeaderValue(req, http::field::accept_encoding));
+            const bool gzip = asset.gzip && encoding == compression::Encoding::Gzip;
+            //an in-memory body is deflated on the way out (see CompressResponse) for a client that takes only that
+            const bool deflate = !gzip && asset.body && encoding == compression::Encoding::Deflate && compressed_bodies_.GetLevel() > 0
+                && asset.size >= compression::MIN_SIZE && compression::IsCompressible(asset.content_type);
+            const std::string etag = gzip ? asset.gzip_etag : deflate ? CodingEtag(asset.etag, "deflate") : asset.etag;
+            const bool not_modified = EtagMatches(HeaderValue(req, http::field::if_none_match), etag);
+            auto response = not_modified ? MakeEmptyResponse(req, http::status::not_modified) : MakeSharedResponse(req, gzip ? asset.gzip : asset.body, asset.content_type);
+            if (gzip && !not_modified)
+                response.set(http::field::content_encoding, "gzip");
+            if (gzip || deflate)
+                response.set(http::field::vary, vary.empty() ? std::string("Accept-Encoding") : std::string(vary) + ", Accept-Encoding");
+            else if (!vary.empty())
+                response.set(http::field::vary, boost::beast::string_view(vary.data(), vary.size()));
+            if (!gzip && !not_modified)
+                response.content_length(asset.size);
+            //a deflated answer gets its ETag when it is compressed
+            const auto& sent_etag = deflate && !not_modified ? asset.etag : etag;
+            response.set(http::field::etag, boost::beast::string_view(sent_etag.data(), sent_etag.size()));
+            response.set(http::field::cache_control, boost::beast::string_view(cache_control.data(), cache_control.size()));
+            if (req.method() == http::verb::head)
+                response.body() = nullptr;  //"Content-Length" stays that of the GET answer
+            return response;
+        }
+
+        //files are served from the in-memory table (see StaticFiles): no filesystem access per request
+        template <typename Body, typename Allocator, typename Send>
+        void GetStaticFile_RequestHand(const http::request<Body, http::basic_fields<Allocator>>& req, Send& send, std::string_view path) {
+            if (path == "/")
+                path = "/index.html";
+            std::string decoded;
+            if (path.find_first_of("%+") != std::string_view::npos) {
+                decoded = UrlDeCode(std::string(path));
+                path = decoded;
+            }
+            if (path.find("/../") != std::string_view::npos || path.ends_with("/..")) {
+                auto response = MakePrebuiltResponse(req, Answer::FileNotAccessible);
+                send(response);
+                return;
+            }
+            auto files = static_files_.Get();
+            auto asset = files->Find(path);
+            if (!asset) {
+                auto response = MakePrebuiltResponse(req, Answer::FileNotFound);
+                send(response);
+                return;
+            }
+            const bool head = req.method() == http::verb::head;
+            //a large file goes from the disk; its gzip copy (if any) is in memory
+            const bool gzip = asset->gzip && compression::Negotiate(HeaderValue(req, http::field::accept_encoding)) == compression::Encoding::Gzip;
+            const bool not_modified = EtagMatches(HeaderValue(req, http::field::if_none_match), gzip ? asset->gzip_etag : asset->etag);
+            //a range is always of the identity form, so "If-Range" must name that; a range of a file that changed
+            //since the client got the rest is not sent
+            std::optional<ByteRange> range;
+            auto range_header = HeaderValue(req, http::field::range);
+            auto if_range = HeaderValue(req, http::field::if_range);
+            if (!head && !not_modified && !range_header.empty() && (if_range.empty() || if_range == asset->etag))
+                range = ParseRange(range_header, asset->size);
+            if (range && range->length == 0) {
+                auto response = MakeEmptyResponse(req, http::status::range_not_satisfiable);
+                response.set(http::field::content_range, "bytes */" + std::to_string(asset->size));
+                response.content_length(0);
+                send(response);
+                return;
+            }
+            const auto set_cache_headers = [asset, this](auto& response) {
+                response.set(http::field::etag, boost::beast::string_view(asset->etag.data(), asset->etag.size()));
+                response.set(http::field::cache_control, static_cache_control_);
+                response.set(http::field::accept_ranges, "bytes");
                 };
-            const auto head_file_response = [&req, this](http::status status, fs::path file_path, std::string content_type) {
-                return this->HEADMakeFileResponse(status, file_path, req.version(), req.keep_alive(), content_type);
+            const auto content_range = [&range, asset]() {
+                return "bytes " + std::to_string(range->first) + "-" + std::to_string(range->first + range->length - 1) + "/" + std::to_string(asset->size);
                 };
-            if (((req.method_string() == "GET") || (req.method_string() == "HEAD")) && ((
-                (static_cast<std::string>(req.target()).substr(0, 4) != "/api") &&
-                (static_cast<std::string>(req.target()) != "/favicon.ico") &&
-                (static_cast<std::string>(req.target()) != "/")) ||
-                (static_cast<std::string>(req.target()) == "/")
-                ))
-            {
-                std::filesystem::path file_path;
-                if (static_cast<std::string>(req.target()) != "/");
-                file_path = path_.string() + UrlDeCode(static_cast<std::string>(req.target()));
-                if (static_cast<std::string>(req.target()) == "/")
-                    file_path = path_.string() + "/index.html";
-                file_path = fs::weakly_canonical(file_path);
-                if (IsAccessibleFile(file_path, path_)) {
-                    if (!IsFileExist(file_path)) {
-                        auto response = text_response(http::status::not_found, "File not found", "text/plain");
-                        send(response);
-                        return true;
-                    }
-                    std::string file_type = GetFileType(file_path.string());
-                    if (req.method_string() == "GET") {
-                        auto response = get_file_response(http::status::ok, file_path, file_type);
-                        send(response);
-                        return true;
-                    }
-                    if (req.method_string() == "HEAD") {
-                        auto response  = head_file_response(http::status::ok, file_path, file_type);
-                        send(response);
-                        return true;
-                    }
+            if (range && asset->body) {
+                std::string_view part(*asset->body);
+                auto response = MakeStringResponse(http::status::partial_content, part.substr(range->first, range->length), req.version(), req.keep_alive(),
+                    boost::beast::string_view(asset->content_type.data(), asset->content_type.size()), http_server::ResourceOf(req.get_allocator()));
+                response.set(http::field::content_range, content_range());
+                set_cache_headers(response);
+                send(response);
+                return;
+            }
+            if (!head && !not_modified && !asset->body && (range || !gzip)) {
+                auto response = MakeFileRangeResponse(asset->file, range.value_or(ByteRange{ 0, asset->size }), req.version(), req.keep_alive(), asset->content_type);
+                if (!response) {
+                    auto not_found = MakePrebuiltResponse(req, Answer::FileNotFound);
+                    send(not_found);
+                    return;
                 }
-                else {
-                    auto response = text_response(http::status::bad_request, "Not access", "text/plain");
-                    send(response);
-                    return true;
+                if (range) {
+                    response->result(http::status::partial_content);
+                    response->set(http::field::content_range, content_range());
                 }
+                set_cache_headers(*response);
+                send(*response);
+                return;
             }
-            return false;
+            auto response = MakeAssetResponse(req, *asset, static_cache_control_);
+            response.set(http::field::accept_ranges, "bytes");
+            send(response);
         }
 
         template <typename Body, typename Allocator, typename Send>
-        void API_AuthGame_RequestHand(const http::request<Body, http::basic_fields<Allocator>>& req, Send& send) {
+        void API_AuthGame_RequestHand(http::request<Body, http::basic_fields<Allocator>>&& req, Send& send) {
+            json::error_code ec;
+            json::value jv = json::parse(req.body(), ec, JsonStorage(req));
+            //parsing error
+            if (ec) {
+                auto response = MakePrebuiltResponse(req, Answer::JsonParseError);
+                send(response);
+                return;
+            }
+            std::string userName;
+            std::string mapId;
+            try {
+                 userName = jv.as_object().at("userName").as_string();
+                 mapId = jv.as_object().at("mapId").as_string();
+            }
+            catch (...) {
+                auto response = MakePrebuiltResponse(req, Answer::EmptyNickname);
+                send(response);
+                return;
+            }
+            //empty name error
+            if (userName == "") {
+                auto response = MakePrebuiltResponse(req, Answer::EmptyNickname);
+                send(response);
+                return;
+            }
+
+            //map not found error
+            if (!game_.FindMap(model::Map::Id(static_cast<std::string>(mapId)))) {
+                auto response = MakePrebuiltResponse(req, Answer::MapNotFound);
+                send(response);
+                return;
+           }
+       
+            //setting player
+            boost::asio::dispatch(strand_, [req = std::move(req), send = std::forward<Send>(send), this, userName = std::move(userName), mapId = std::move(mapId)] () {
             const auto json_text_response = [&req, this](json::value&& jv, http::status status) {
-                std::string answ = json::serialize(jv);
-                StringResponse response = MakeStringResponse(status, answ, req.version(), req.keep_alive(), "application/json");
-                response.set(http::field::cache_control, "no-cache");
-                return response;
+                return this->MakeJsonResponse(req, jv, status);
                 };
+            auto [players_token, player] = app::JoinGame(game_, players_, tokens_, userName, model::Map::Id(mapId));
+            recorder_.RecordJoin(players_token, userName, mapId);
 
-            if ((req.method_string() == "POST") &&
-                (static_cast<std::string>(req.target()) == Endpoints::API_AuthGame_Endpoint())) {
-                json::error_code ec;
-                json::value jv = json::parse(req.body(), ec);
-                //parsing error
-                if (ec) {
-                    auto response = json_text_response(JsonParseError(),http::status::bad_request);
-                    send(response);
-                    return;
-                }
-                std::string userName;
-                std::string mapId;
-                try {
-                     userName = jv.as_object().at("userName").as_string();
-                     mapId = jv.as_object().at("mapId").as_string();
-                }
-                catch (...) {
-                    auto response = json_text_response(EmptyNickname(), http::status::bad_request);
-                    send(response);
-                    return;
-                }
-                //empty name error
-                if (userName == "") {
-                    auto response = json_text_response(EmptyNickname(), http::status::bad_request);
-                    send(response);
-                    return;
-                }
+            if (f) {
+                Serialize();
+                f = false;
+            }
+            json::value answer = {
+                {"authToken", players_token},
+                {"playerId", player->GetDogId()}
+            };
+            auto response = json_text_response(std::move(answer), http::status::ok);
+            send(response);
+                });
+        }
 
-                //map not found error
-                if (!game_.FindMap(model::Map::Id(static_cast<std::string>(mapId)))) {
-                    auto response = json_text_response(MapNotFound(), http::status::not_found);
-                    send(response);
-                    return;
-               }
-           
-                //setting player
-                boost::asio::dispatch(strand_, [req, send = std::forward<Send>(send), this, userName, mapId] () {
-                const auto json_text_response = [&req, this](json::value&& jv, http::status status) {
-                    std::string answ = json::serialize(jv);
-                    StringResponse response = this->MakeStringResponse(status, answ, req.version(), req.keep_alive(), "application/json");
+        template <typename Body, typename Allocator, typename Send>
+        void API_PlayersList_RequestHand(http::request<Body, http::basic_fields<Allocator>>&& req, Send& send) {
+            API_PerfomActionWithToken(std::move(req), std::forward<Send>(send), [this](const auto& req, app::Player& player, const app::Token128&) {
+                auto gs = player.GetGameSession();
+                if (AcceptsBinary(req)) {
+                    std::string answ;
+                    binary_writer::BinaryWriter writer(answ);
+                    binary_writer::WritePlayers(writer, *gs);
+                    auto response = MakeStringResponse(http::status::ok, answ, req.version(), req.keep_alive(), boost::beast::string_view(binary_writer::CONTENT_TYPE.data(), binary_writer::CONTENT_TYPE.size()), http_server::ResourceOf(req.get_allocator()));
                     response.set(http::field::cache_control, "no-cache");
+                    response.set(http::field::vary, "Accept");
                     return response;
-                    };
-                //looking for (creating) game sessions
-                std::shared_ptr<model::GameSession> gs = this->game_.FindGameSession(model::Map::Id(static_cast<std::string>(mapId)));
-                //creating dog; creating player for that dog and that game session; creating token for that player 
-                auto players_token = this->tokens_.AddPlayer(players_.Add(std::make_shared<model::Dog>(static_cast<std::string>(userName)),gs));
-               (*(this->tokens_).FindPlayerByToken(players_token)).SetRetirementTime(game_.GetDogRetirementTime() * 1000);
-
-                gs->GenerateForced();
-                if (f) {
-                    Serialize();
-                    f = false;
                 }
-                json::value answer = {
-                    {"authToken", players_token},
-                    {"playerId", (*(this->tokens_).FindPlayerByToken(players_token)).GetDogId()}
+                auto answer = PlayersToJson(*gs);
+                auto response = MakeJsonResponse(req, answer, http::status::ok);
+                response.set(http::field::vary, "Accept");
+                return response; });
+        }
+
+        //state is sent from the snapshot of the session without entering the strand; only a snapshot made
+        //stale by a join or a move since the last tick is encoded again (on the strand).
+        //With "?since=<tick>" only the changes after that tick are sent (see json_writer::WriteGameStateSince).
+        //With "?wait=<tick>" the request is parked until the session records a later tick (or for
+        //StateWaiters::TIMEOUT) and answered from the snapshot of that tick; the tick is in the "X-Game-Tick" header.
+        //With "?radius=<r>" only the dogs and lost objects near the player's dog are sent (see json_writer::StateCells).
+        //The full state is sent in the binary format of binary_writer to clients that accept it
+        template <typename Body, typename Allocator, typename Send>
+        void API_GameState_RequestHand(http::request<Body, http::basic_fields<Allocator>>&& req, Send& send, std::string_view query) {
+            const auto get_tick_param = [query](std::string_view name, std::optional<uint64_t>& tick) {
+                auto param = GetQueryParam(query, name);
+                if (!param)
+                    return true;
+                uint64_t value = 0;
+                auto [ptr, ec] = std::from_chars(param->data(), param->data() + param->size(), value);
+                if (ec != std::errc() || ptr != param->data() + param->size())
+                    return false;
+                tick = value;
+                return true;
                 };
-                auto response = json_text_response(std::move(answer), http::status::ok);
+            const auto get_radius_param = [query](std::optional<double>& radius) {
+                auto param = GetQueryParam(query, "radius");
+                if (!param)
+                    return true;
+                double value = 0;
+                auto [ptr, ec] = std::from_chars(param->data(), param->data() + param->size(), value);
+                if (ec != std::errc() || ptr != param->data() + param->size() || !(value > 0) || !std::isfinite(value))
+                    return false;
+                radius = value;
+                return true;
+                };
+            std::optional<uint64_t> since;
+            std::optional<uint64_t> wait;
+            std::optional<double> radius;
+            //a delta has no way to tell that a dog has left the view, so "since" and "radius" do not mix
+            if (!get_tick_param("since", since) || !get_tick_param("wait", wait) || !get_radius_param(radius) || (since && radius)) {
+                auto response = MakePrebuiltResponse(req, Answer::BadRequest);
+                send(response);
+                return;
+            }
+            auto token = AuthToken(req);
+            if (!token) {
+                auto response = MakePrebuiltResponse(req, Answer::AuthorizationMissing);
                 send(response);
-                    });
                 return;
             }
-            else if (static_cast<std::string>(req.target()) == Endpoints::API_AuthGame_Endpoint()) {
-                auto response = json_text_response(NotPostRequest(), http::status::method_not_allowed);
-                response.set(http::field::allow, "POST");
+            auto player = tokens_.FindPlayerByToken(*token);
+            if (!player) {
+                auto response = MakePrebuiltResponse(req, Answer::PlayerNotFound);
                 send(response);
                 return;
             }
-            return;
+            auto gs = player->GetGameSession();
+            auto encoding = model::StateEncoding::Json;
+            if (!since && !radius && AcceptsBinary(req)) {
+                encoding = model::StateEncoding::Binary;
+                binary_state_used_.store(true, std::memory_order_relaxed);
+            }
+            if (!since && !wait && !radius) {
+                if (auto snapshot = gs->GetStateSnapshot(encoding)) {
+                    auto response = MakeSharedResponse(req, std::move(snapshot), ContentType(encoding));
+                    //json or binary by "Accept", so a cache must not mix them up
+                    response.set(http::field::vary, "Accept");
+                    send(response);
+                    return;
+                }
+            }
+            boost::asio::dispatch(strand_, [send = std::forward<Send>(send), this, req = std::move(req), gs = std::move(gs), dog = player->GetDog(), since, wait, radius, encoding]() mutable {
+                auto answer = [send = std::move(send), this, req = std::move(req), gs, dog = std::move(dog), since, radius, encoding]() {
+                    auto body = since ? EncodeStateSince(*gs, *since)
+                        : radius ? EncodeStateArea(*gs, dog->GetPosition(), *radius)
+                        : CurrentStateSnapshot(*gs, encoding);
+                    auto response = MakeSharedResponse(req, std::move(body), ContentType(encoding));
+                    response.set("X-Game-Tick", std::to_string(gs->GetHistory().GetTick()));
+                    response.set(http::field::vary, "Accept");
+                    send(response);
+                    };
+                if (wait && gs->GetHistory().GetTick() <= *wait)
+                    state_waiters_.Park(std::move(gs), *wait, std::move(answer));
+                else
+                    answer();
+                });
         }
 
         template <typename Body, typename Allocator, typename Send>
-        void API_PlayersList_RequestHand(const http::request<Body, http::basic_fields<Allocator>>& req, Send& send) {
-            const auto json_text_response = [&req, this](json::value&& jv, http::status status) {
-                std::string answ = json::serialize(jv);
-                StringResponse response = MakeStringResponse(status, answ, req.version(), req.keep_alive(), "application/json");
-                response.set(http::field::cache_control, "no-cache");
-                return response;
-                };
-            if (((req.method_string() == "GET") || (req.method_string() == "HEAD"))&&
-                (static_cast<std::string>(req.target()) == Endpoints::API_PlayersList_Endpoint())) {
-           
-                boost::asio::dispatch(strand_, [send = std::forward<Send>(send), this, req]() {
-                API_PerfomActionWithToken(req, send, [this](const app::Token& token) {
-                    auto gs = this->tokens_.FindPlayerByToken(token)->GetGameSession();
-                    json::value name = {
-                         {"name", gs->GetDogs().begin()->second->GetName()}
-                    };
-                    json::value answer = { {std::to_string(gs->GetDogs().begin()->second->GetId()), name} };
-                    for (auto p = (gs->GetDogs().begin()); p != gs->GetDogs().end(); ++p) {
-                        name = {
-                         {"name", p->second->GetName()}
-                        };
-                        answer.get_object().emplace(std::to_string(p->second->GetId()), name);
-                    }
-                    return answer; });
-                });
+        void API_MovePlayer_RequestHand(http::request<Body, http::basic_fields<Allocator>>&& req, Send& send) {
+            if (HeaderValue(req, http::field::content_type) != "application/json") {
+                auto response = MakePrebuiltResponse(req, Answer::InvalidContentType);
+                send(response);
+                return;
             }
-            else if(static_cast<std::string>(req.target()) == Endpoints::API_PlayersList_Endpoint()){
-                auto response = json_text_response(InvalidMethod(), http::status::method_not_allowed);
-                response.set(http::field::allow, "GET, HEAD");
+            app::Token128 token;
+            auto player = FindRequestPlayer(req, send, token);
+            if (!player)
+                return;
+            json::error_code ec;
+            json::value jv = json::parse(req.body(), ec, JsonStorage(req));
+            if (ec || !jv.is_object() || !jv.as_object().contains("move") || !jv.as_object().at("move").is_string()) {
+                auto response = MakePrebuiltResponse(req, Answer::ErrorParseAction);
                 send(response);
                 return;
             }
-            return;
+            //answered once the simulation has applied the command
+            EnqueueMove({ std::move(player), token, std::string(jv.as_object().at("move").as_string()),
+                [send = std::forward<Send>(send), this, version = req.version(), keep_alive = req.keep_alive()](Answer answer) mutable {
+                    auto response = MakePrebuiltResponse(answer, version, keep_alive, std::pmr::get_default_resource());
+                    send(response);
+                } });
         }
 
+        //[{"op":"action","token":..,"move":"L"},{"op":"state"},{"op":"players"},...] -> [{"status":..,"body":..},...]
+        //Tokens and the rate limits of the operations are checked here, then the whole batch runs in one visit of the strand
         template <typename Body, typename Allocator, typename Send>
-        void API_GameState_RequestHand(const http::request<Body, http::basic_fields<Allocator>>& req, Send& send) {
-            const auto json_text_response = [&req, this](json::value&& jv, http::status status) {
-                std::string answ = json::serialize(jv);
-                StringResponse response = MakeStringResponse(status, answ, req.version(), req.keep_alive(), "application/json");
-                response.set(http::field::cache_control, "no-cache");
-                return response;
-                };
-            if (((req.method_string() == "GET") || (req.method_string() == "HEAD")) &&
-                (static_cast<std::string>(req.target()) == Endpoints::API_GameState_Endpoint())) {
-
-                boost::asio::dispatch(strand_, [send = std::forward<Send>(send), this, req]() {
-                API_PerfomActionWithToken(req, send, [this](const app::Token& token) {
-                    auto gs = this->tokens_.FindPlayerByToken(token)->GetGameSession();
-                    std::vector<std::pair<size_t, model::LostObject>> bag;
-                    for (auto& b : gs->GetDogs().begin()->second->GetBag())
-                        bag.push_back({ b.first, b.second });
-                    json::value information_about_dog = {
-                        {"pos", std::vector<double>({gs->GetDogs().begin()->second->GetPosition().x, gs->GetDogs().begin()->second->GetPosition().y})},
-                        {"speed",std::vector<double>({gs->GetDogs().begin()->second->GetSpeed().s_x, gs->GetDogs().begin()->second->GetSpeed().s_y}) },
-                        {"dir", gs->GetDogs().begin()->second->GetDirectionToString()},
-                        {"bag", bag},
-                        {"score", gs->GetDogs().begin()->second->GetScore()}
-                    };                
-                    json::value players = {
-                        {std::to_string(gs->GetDogs().begin()->second->GetId()), information_about_dog}
-                    };
-                    for (auto p = (gs->GetDogs().begin()); p != gs->GetDogs().end(); ++p) {
-                        bag.clear();
-                        for (auto& b : p->second->GetBag())
-                            bag.push_back({ b.first, b.second });
-                        information_about_dog = {
-                           {"pos", {p->second->GetPosition().x, p->second->GetPosition().y}},
-                           {"speed",std::vector<double>({p->second->GetSpeed().s_x, p->second->GetSpeed().s_y}) },
-                           {"dir", p->second->GetDirectionToString()},
-                           {"bag", bag},
-                           {"score", p->second->GetScore()}
-                        };
-                        players.get_object().emplace(std::to_string(p->second->GetId()), information_about_dog);
-                    }
-                    json::value information_about_lost_object;
-                    json::value lost_objects;
-                    if (gs->GetCurrentLostObjects().size() != 0) {
-
-                        information_about_lost_object = {
-                            {"type", gs->GetCurrentLostObjects().begin()->second.type},
-                            {"pos", std::vector<double>({gs->GetCurrentLostObjects().begin()->second.position.x,gs->GetCurrentLostObjects().begin()->second.position.y})}
-                        };
-                        lost_objects = {
-                        {std::to_string(gs->GetCurrentLostObjects().begin()->first), information_about_lost_object}
-                        };
-                        for (auto p = gs->GetCurrentLostObjects().begin(); p != gs->GetCurrentLostObjects().end(); ++p) {
-                            if (p == gs->GetCurrentLostObjects().begin())
-                                continue;
-                            information_about_lost_object = {
-                                {"type", p->second.type},
-                                {"pos", {p->second.position.x, p->second.position.y}}
-                            };
-                            lost_objects.get_object().emplace(std::to_string(p->first), information_about_lost_object);
-                        }
-                    }
-
-                    json::value answer = {
-                        { "players", players },
-                        {"lostObjects", lost_objects }
-                    };
-                    return answer; }); 
-                });
+        void API_Batch_RequestHand(http::request<Body, http::basic_fields<Allocator>>&& req, Send& send, const boost::asio::ip::address& remote) {
+            if (HeaderValue(req, http::field::content_type) != "application/json") {
+                auto response = MakePrebuiltResponse(req, Answer::InvalidContentType);
+                send(response);
+                return;
             }
-             else if (static_cast<std::string>(req.target()) == Endpoints::API_GameState_Endpoint()) {
-                auto response = json_text_response(InvalidMethod(), http::status::method_not_allowed);
-                response.set(http::field::allow, "GET, HEAD");
+            json::error_code ec;
+            json::value jv = json::parse(req.body(), ec, JsonStorage(req));
+            if (ec || !jv.is_array()) {
+                auto response = MakePrebuiltResponse(req, Answer::JsonParseError);
                 send(response);
-                return;           
-             }
-             return;
-        }
-
-        template <typename Body, typename Allocator, typename Send>
-        void API_MovePlayer_RequestHand(const http::request<Body, http::basic_fields<Allocator>>& req, Send& send) {
-            const auto json_text_response = [&req, this](json::value&& jv, http::status status) {
-                std::string answ = json::serialize(jv);
-                StringResponse response = MakeStringResponse(status, answ, req.version(), req.keep_alive(), "application/json");
-                response.set(http::field::cache_control, "no-cache");
-                return response;
-                };
-
-            if ((req.method_string() == "POST") &&
-                (static_cast<std::string>(req.target()) == Endpoints::API_MovePlayer_Endpoint())) {
-                try {
-                    if (req.base()["Content-Type"].to_string() != "application/json")
-                        throw std::exception();
-                }
-                catch (...) {
-                    auto response = json_text_response(InvalidContentType(), http::status::bad_request);
-                    send(response);
-                    return;
-                }
-                boost::asio::dispatch(strand_, [send = std::forward<Send>(send), this, req]() {
-                API_PerfomActionWithToken(req, send, [this, &req](const app::Token& token) {
-                    auto player = this->tokens_.FindPlayerByToken(token);
-                    double dog_speed = this->tokens_.FindPlayerByToken(token)->GetGameSession()->GetDogSpeed();
-
-                    json::error_code ec;
-                    json::value jv = json::parse(req.body(), ec);
-                    if (ec || !jv.as_object().contains("move"))
-                        return ErrorParseAction();
-                
-                    std::string dir = static_cast<std::string>(jv.as_object().at("move").as_string());
-                   // std::lock_guard lg(m);
-                    if (dir == "L") {
-                        player->SetDogSpeed(-dog_speed, 0.);
-                        player->SetDogDirection(dir);
-                    }
-                    else if (dir == "R") {
-                        player->SetDogSpeed(dog_speed, 0.);
-                        player->SetDogDirection(dir);
-                    }
-                    else if (dir == "U") {
-                        player->SetDogSpeed(0., -dog_speed);
-                        player->SetDogDirection(dir);
-                    }
-                    else if (dir == "D") {
-                        player->SetDogSpeed(0., dog_speed);
-                        player->SetDogDirection(dir);
-                    }
-                    else if (dir == "") {
-                        player->SetDogSpeed(0., 0.);
-                        player->SetDogDirection("U");
-                    }
-                    else {
-                        return ErrorParseAction();
-                    }
-                    json::value answer = json::object();
-                    return answer;});
-                });
-
+                return;
             }
-            else if (static_cast<std::string>(req.target()) == Endpoints::API_MovePlayer_Endpoint()) {
-                auto response = json_text_response(NotPostRequest(), http::status::method_not_allowed);
-                response.set(http::field::allow, "POST");
+            if (jv.as_array().size() > MAX_BATCH_SIZE) {
+                auto response = MakePrebuiltResponse(req, Answer::BadRequest);
                 send(response);
                 return;
             }
-            return;
+            std::string_view header_token = AuthToken(req).value_or(std::string_view{});
+            std::vector<BatchOperation> operations;
+            operations.reserve(jv.as_array().size());
+            for (auto& operation : jv.as_array()) {
+                operations.push_back(ParseBatchOperation(operation, header_token));
+                //an operation costs what the request of its own endpoint would, so a batch does not get around the limits
+                auto& parsed = operations.back();
+                if (!parsed.error && TakeRateLimit(BatchOperation::RouteOf(parsed.kind), remote, parsed.token))
+                    parsed.error = Answer::TooManyRequests;
+            }
+            boost::asio::dispatch(strand_, [send = std::forward<Send>(send), this, version = req.version(), keep_alive = req.keep_alive(), operations = std::move(operations)]() mutable {
+                auto body = RunBatch(operations);
+                auto response = MakeStringResponse(http::status::ok, body, version, keep_alive, "application/json");
+                response.set(http::field::cache_control, "no-cache");
+                send(response);
+                });
         }
 
         template <typename Body, typename Allocator, typename Send>
-        void API_TimeTick_RequestHand(const http::request<Body, http::basic_fields<Allocator>>& req, Send& send) {
-            const auto json_text_response = [&req, this](json::value&& jv, http::status status) {
-                std::string answ = json::serialize(jv);
-                StringResponse response = MakeStringResponse(status, answ, req.version(), req.keep_alive(), "application/json");
-                response.set(http::field::cache_control, "no-cache");
-                return response;
-                };
-
-            if ((req.method_string() == "POST") &&
-                (static_cast<std::string>(req.target()) == Endpoints::API_TimeTick_Endpoint())) {
-                json::error_code ec;
-                json::value jv = json::parse(req.body(), ec);
-                if (ec || !jv.as_object().contains("timeDelta")) {
-                    auto response = json_text_response(ErrorParseTick(), http::status::bad_request);
-                    send(response);
-                    return;
-                }
-                if (!jv.as_object().at("timeDelta").if_int64()) {
-                    auto response = json_text_response(ErrorParseTick(), http::status::bad_request);
-                    send(response);
-                    return;
-                }
-            
-
-                boost::asio::dispatch(strand_, [send = std::forward<Send>(send), this, jv, req]() {
-                const auto json_text_response = [&req, this](json::value&& jv, http::status status) {
-                    std::string answ = json::serialize(jv);
-                    StringResponse response = this->MakeStringResponse(status, answ, req.version(), req.keep_alive(), "application/json");
-                    response.set(http::field::cache_control, "no-cache");
-                    return response;
-                    };
-                int time_delta = jv.as_object().at("timeDelta").as_int64(); //время в миллисикундах
-                Tick(time_delta * 1ms);
-               // this->players_.MoveAllDogs(time_delta);
-                json::value answer = json::object();
-                auto response = json_text_response(std::move(answer), http::status::ok);
+        void API_TimeTick_RequestHand(http::request<Body, http::basic_fields<Allocator>>&& req, Send& send) {
+            json::error_code ec;
+            json::value jv = json::parse(req.body(), ec, JsonStorage(req));
+            if (ec || !jv.as_object().contains("timeDelta")) {
+                auto response = MakePrebuiltResponse(req, Answer::ErrorParseTick);
                 send(response);
-                });
                 return;
             }
-            else if (static_cast<std::string>(req.target()) == Endpoints::API_TimeTick_Endpoint()) {
-                auto response = json_text_response(NotPostRequest(), http::status::method_not_allowed);
-                response.set(http::field::allow, "POST");
+            if (!jv.as_object().at("timeDelta").if_int64()) {
+                auto response = MakePrebuiltResponse(req, Answer::ErrorParseTick);
                 send(response);
                 return;
             }
-            return;
+            int64_t time_delta = jv.as_object().at("timeDelta").as_int64(); //время в миллисикундах
+
+            boost::asio::dispatch(strand_, [send = std::forward<Send>(send), this, time_delta, req = std::move(req)]() {
+            Tick(time_delta * 1ms);
+           // this->players_.MoveAllDogs(time_delta);
+            auto response = MakePrebuiltResponse(req, Answer::EmptyObject);
+            send(response);
+            });
         }
 
         template <typename Body, typename Allocator, typename Send>
-        void API_GetRecords_RequestHand(const http::request<Body, http::basic_fields<Allocator>>& req, Send& send) {
-            const auto json_text_response = [&req, this](json::value&& jv, http::status status) {
-                std::string answ = json::serialize(jv);
-                StringResponse response = MakeStringResponse(status, answ, req.version(), req.keep_alive(), "application/json");
-                response.set(http::field::cache_control, "no-cache");
-                return response;
+        void API_GetRecords_RequestHand(http::request<Body, http::basic_fields<Allocator>>&& req, Send& send, std::string_view query) {
+            const auto get_int_param = [query](std::string_view name, int& value) {
+                auto param = GetQueryParam(query, name);
+                if (!param)
+                    return true;
+                auto [ptr, ec] = std::from_chars(param->data(), param->data() + param->size(), value);
+                return ec == std::errc() && ptr == param->data() + param->size() && value >= 0;
                 };
-
-            if ((req.method_string() == "GET") &&
-                (static_cast<std::string>(req.target()).substr(0, Endpoints::API_GetRecords_Endpoint().length()) == Endpoints::API_GetRecords_Endpoint())) {
-                
-                boost::asio::dispatch(strand_, [send = std::forward<Send>(send), this, req]() {
-                    const auto json_text_response = [&req, this](json::value&& jv, http::status status) {
-                        std::string answ = json::serialize(jv);
-                        StringResponse response = this->MakeStringResponse(status, answ, req.version(), req.keep_alive(), "application/json");
-                        response.set(http::field::cache_control, "no-cache");
-                        return response;
-                    };
-                    int maxItems = 100;
-                    int start = 0;
-                    
-                    if (static_cast<std::string>(req.target()).length() > Endpoints::API_GetRecords_Endpoint().length()) {
-                        if (static_cast<std::string>(req.target()).substr(Endpoints::API_GetRecords_Endpoint().length() + 1, 5) == "start")
-                        {
-                            std::string temp = static_cast<std::string>(req.target()).substr(Endpoints::API_GetRecords_Endpoint().length() + 7);
-                            int i = 0;
-                            std::string string_start;
-                            std::string string_maxItems;
-                            while (temp[i] != '&') {
-                                string_start += temp[i++];
-                                if (i == temp.size())
-                                    break;
-                            }
-                            if (i != temp.size()) {
-                                i += 10;
-                                std::cout << temp[i] << "\n";
-                                while (i != temp.size()) {
-                                    string_maxItems += temp[i++];
-                                }
-                            }
-                            start = std::stoi(string_start);
-                            maxItems = std::stoi(string_maxItems);
-                        }
-                    }
-                    if (maxItems > 100)
-                        return;
-
-                    auto records = database_.GetRecords(); 
-                    std::vector<postgres_tools::Record> sub_records;
-                    if(start + maxItems > records.size())
-                        sub_records.assign(records.begin() + start, records.end());
-                    else
-                        sub_records.assign(records.begin() + start, records.begin() + start + maxItems);
-                    boost::json::array result;
-                    for (auto& p : sub_records) {
-                        result.push_back({
-                            {"name", p.name},
-                            {"score", p.score},
-                            {"playTime", p.play_time}
-                            });
-                    }
-
-                    json::value answer = result;
-                    auto response = json_text_response(std::move(answer), http::status::ok);
-                    send(response);
-                    });
-                return;
-            }
-            else if (static_cast<std::string>(req.target()) == Endpoints::API_GetRecords_Endpoint()) {
-                auto response = json_text_response(NotPostRequest(), http::status::method_not_allowed);
-                response.set(http::field::allow, "GET");
+            int maxItems = 100;
+            int start = 0;
+            if (!get_int_param("start", start) || !get_int_param("maxItems", maxItems) || maxItems > 100) {
+                auto response = MakePrebuiltResponse(req, Answer::BadRequest);
                 send(response);
                 return;
             }
-            return;
+
+            boost::asio::dispatch(strand_, [send = std::forward<Send>(send), this, req = std::move(req), start, maxItems]() mutable {
+                const auto json_text_response = [&req, this](json::value&& jv, http::status status) {
+                    return this->MakeJsonResponse(req, jv, status);
+                };
+                auto records = database_.GetRecords(); 
+                std::vector<postgres_tools::Record> sub_records;
+                if (start >= records.size())
+                    start = records.size();
+                if(start + maxItems > records.size())
+                    sub_records.assign(records.begin() + start, records.end());
+                else
+                    sub_records.assign(records.begin() + start, records.begin() + start + maxItems);
+                boost::json::array result;
+                for (auto& p : sub_records) {
+                    result.push_back({
+                        {"name", p.name},
+                        {"score", p.score},
+                        {"playTime", p.play_time}
+                        });
+                }
+
+                json::value answer = result;
+                auto response = json_text_response(std::move(answer), http::status::ok);
+                send(response);
+                });
         }
-        
 
-        template <typename Body, typename Allocator, typename Send>
-        void operator()(http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send) {
-            const auto text_response = [&req, this](http::status status, std::string_view text, boost::beast::string_view content_type) {
-                return this->MakeStringResponse(status, text, req.version(), req.keep_alive(), content_type);
-            };
- 
-           
-            if (static_cast<std::string>(req.target()) == Endpoints::API_Maps_Endpoint().substr(0,12) || 
-                static_cast<std::string>(req.target()).substr(0, 13) == Endpoints::API_Maps_Endpoint()) {
-                GetAPI_info_RequestHand(req, send);
+        //websocket of /api/v1/game/socket: the token is checked once here, then the state of every tick is
+        //pushed to the socket (a delta since the last frame the client got, or the full snapshot with "?mode=full")
+        //and frames {"move":"L"} move the dog. Other upgrade requests are handled as ordinary ones
+        template <typename Body, typename Allocator, typename Send, typename Accept>
+        void Upgrade(http::request<Body, http::basic_fields<Allocator>>&& req, Send& send, Accept& accept, const boost::asio::ip::address& remote = {}) {
+            const RouteMatch match = MatchRoute({ req.target().data(), req.target().size() });
+            if (match.entry && match.entry->route == Route::Spectate) {
+                API_Spectate_Upgrade(std::move(req), send, accept, match.query, remote);
                 return;
             }
-            if (GetStaticFile_RequestHand(req, send))
+            if (!match.entry || match.entry->route != Route::GameSocket) {
+                (*this)(std::move(req), send, remote);
                 return;
-            if (static_cast<std::string>(req.target()) == Endpoints::API_AuthGame_Endpoint()) {
-                API_AuthGame_RequestHand(req, send);
+            }
+            if (!CheckRateLimit(req, send, Route::GameSocket, remote))
+                return;
+            auto mode = GetQueryParam(match.query, "mode").value_or("delta");
+            if (mode != "delta" && mode != "full") {
+                auto response = MakePrebuiltResponse(req, Answer::BadRequest);
+                send(response);
                 return;
             }
-            if (static_cast<std::string>(req.target()) == Endpoints::API_PlayersList_Endpoint()) {
-                API_PlayersList_RequestHand(req, send);
+            //browsers cannot set headers of a websocket request, so the token may also come as "?token="
+            auto token = AuthToken(req);
+            if (!token)
+                token = GetQueryParam(match.query, "token");
+            if (!token || token->size() != 32) {
+                auto response = MakePrebuiltResponse(req, Answer::AuthorizationMissing);
+                send(response);
                 return;
             }
-            if (static_cast<std::string>(req.target()) == Endpoints::API_GameState_Endpoint()) {
-                API_GameState_RequestHand(req, send);
+            auto player_token = app::Token128::Parse(*token).value_or(app::Token128{});
+            auto player = tokens_.FindPlayerByToken(*token);
+            if (!player) {
+                auto response = MakePrebuiltResponse(req, Answer::PlayerNotFound);
+                send(response);
                 return;
             }
-            if (static_cast<std::string>(req.target()) == Endpoints::API_MovePlayer_Endpoint()) {
-                API_MovePlayer_RequestHand(req, send);
+            uint64_t id = next_socket_id_.fetch_add(1, std::memory_order_relaxed);
+            auto ws = accept(std::move(req),
+                [this, player_token, remote](std::string_view frame) {
+                    OnSocketFrame(player_token, remote, frame);
+                },
+                [this, id]() {
+                    boost::asio::dispatch(strand_, [this, id]() {
+                        if (!game_sockets_.erase(id))
+                            closed_sockets_.insert(id);
+                        });
+                });
+            boost::asio::dispatch(strand_, [this, id, ws = std::move(ws), player_token, gs = player->GetGameSession(), full = mode == "full"]() mutable {
+                if (closed_sockets_.erase(id))
+                    return;
+                game_sockets_.emplace(id, GameSocket{ std::move(ws), player_token, std::move(gs), full });
+                });
+        }
+
+        //read-only websocket of /api/v1/game/spectate?map=<id> without a token: the snapshot of every tick of
+        //the session of the map, from the first tick after someone has joined it. Frames of the spectator are
+        //ignored; an address has at most MAX_SPECTATORS_PER_ADDRESS of them open
+        template <typename Body, typename Allocator, typename Send, typename Accept>
+        void API_Spectate_Upgrade(http::request<Body, http::basic_fields<Allocator>>&& req, Send& send, Accept& accept, std::string_view query, const boost::asio::ip::address& remote) {
+            auto map_id = GetQueryParam(query, "map");
+            model::Map::Id id{ std::string(map_id.value_or("")) };
+            if (!map_id || !game_.FindMap(id)) {
+                auto response = MakePrebuiltResponse(req, Answer::MapNotFound);
+                send(response);
                 return;
             }
-            if (static_cast<std::string>(req.target()) == Endpoints::API_TimeTick_Endpoint() && !IsAutomaticTick) {
-                API_TimeTick_RequestHand(req, send);
+            if (!CheckRateLimit(req, send, Route::Spectate, remote))
                 return;
+            if (!TakeSpectatorSlot(remote)) {
+                auto response = MakePrebuiltResponse(req, Answer::TooManyRequests);
+                send(response);
+                return;
+            }
+            uint64_t spectator_id = next_socket_id_.fetch_add(1, std::memory_order_relaxed);
+            auto ws = accept(std::move(req),
+                [](std::string_view) {
+                },
+                [this, id, spectator_id, remote]() {
+                    ReleaseSpectatorSlot(remote);
+                    boost::asio::dispatch(strand_, [this, id, spectator_id]() {
+                        if (!spectators_[*id].sockets.erase(spectator_id))
+                            closed_sockets_.insert(spectator_id);
+                        });
+                });
+            boost::asio::dispatch(strand_, [this, id = std::move(id), spectator_id, ws = std::move(ws)]() mutable {
+                if (closed_sockets_.erase(spectator_id))
+                    return;
+                auto& group = spectators_[*id];
+                if (!group.session)
+                    group.session = game_.FindRunningGameSession(id);
+                if (group.session)
+                    ws->Push(CurrentStateSnapshot(*group.session));
+                group.sockets.emplace(spectator_id, Spectator{ std::move(ws) });
+                });
+        }
+
+        //answers are compressed on the way out if the client accepts it (see CompressResponse)
+        //"remote" is the address of the client; an unspecified one is not rate limited
+        template <typename Body, typename Allocator, typename Send>
+        void operator()(http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send, const boost::asio::ip::address& remote = {}) {
+            auto encoding = compression::Negotiate(HeaderValue(req, http::field::accept_encoding));
+            RouteRequest(std::move(req), [send = std::forward<Send>(send), this, encoding](auto&& response) {
+                CompressResponse(response, encoding);
+                send(response);
+                }, remote);
+        }
+
+        template <typename Body, typename Allocator, typename Send>
+        void RouteRequest(http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send, const boost::asio::ip::address& remote = {}) {
+            const RouteMatch match = MatchRoute({ req.target().data(), req.target().size() });
+            const routing::RouteEntry* entry = match.entry;
+            if (entry && entry->route == Route::TimeTick && IsAutomaticTick)
+                entry = nullptr;
+            if (entry && !routing::IsAllowed(entry->methods, req.method())) {
+                if (entry->method_error) {
+                    auto response = MakePrebuiltResponse(req, *entry->method_error, entry->allow);
+                    send(response);
+                    return;
+                }
+                entry = nullptr;
             }
-            if (static_cast<std::string>(req.target()).substr(0, Endpoints::API_GetRecords_Endpoint().length()) == Endpoints::API_GetRecords_Endpoint()) {
-                API_GetRecords_RequestHand(req, send);
+            if (entry && !CheckRateLimit(req, send, entry->route, remote))
                 return;
+
+            if (entry) {
+                switch (entry->route) {
+                case Route::MapsList:
+                    API_MapsList_RequestHand(req, send);
+                    return;
+                case Route::Map:
+                    API_Map_RequestHand(req, send, match.map_id);
+                    return;
+                case Route::MapTile:
+                    API_MapTile_RequestHand(req, send, match.map_id, match.tile);
+                    return;
+                case Route::AuthGame:
+                    API_AuthGame_RequestHand(std::move(req), send);
+                    return;
+                case Route::PlayersList:
+                    API_PlayersList_RequestHand(std::move(req), send);
+                    return;
+                case Route::GameState:
+                    API_GameState_RequestHand(std::move(req), send, match.query);
+                    return;
+                case Route::MovePlayer:
+                    API_MovePlayer_RequestHand(std::move(req), send);
+                    return;
+                case Route::Batch:
+                    API_Batch_RequestHand(std::move(req), send, remote);
+                    return;
+                case Route::TimeTick:
+                    API_TimeTick_RequestHand(std::move(req), send);
+                    return;
+                case Route::GetRecords:
+                    API_GetRecords_RequestHand(std::move(req), send, match.query); //query is parsed before "req" is moved
+                    return;
+                case Route::GameSocket:
+                case Route::Spectate: {
+                    auto response = MakePrebuiltResponse(req, Answer::UpgradeRequired);
+                    response.set(http::field::upgrade, "websocket");
+                    send(response);
+                    return;
+                }
+                case Route::StaticFile:
+                    GetStaticFile_RequestHand(req, send, match.path);
+                    return;
+                }
             }
 
-           std::string answ = json::serialize(BadRequest());   //invalid request
-           auto response = text_response(http::status::bad_request, answ, "application/json");
-           response.set(http::field::cache_control, "no-cache");
+           auto response = MakePrebuiltResponse(req, Answer::BadRequest);   //invalid request
            send(response);
-           return;
         }
 
         void Tick(std::chrono::milliseconds time_delta) {
+           ApplyMoves();
            game_timer_.Tick(time_delta);       
+           boost::asio::dispatch(strand_, [this]() {
+               PublishStateSnapshots();
+               state_waiters_.Release();
+               PushGameSockets();
+               PushSpectators();
+               });
         }
 
         void SetAutomaticTick() {
@@ -702,6 +1215,15 @@ namespace http_handler {
             serializating_listener_.Serialize();
         }
 
+        //every state-changing input is written to "record_file_path" from now on (see app::ActionRecorder)
+        void StartRecording(const fs::path& record_file_path, uint64_t seed) {
+            recorder_.Open(record_file_path, seed);
+        }
+
+        void StopRecording() {
+            recorder_.Close(game_);
+        }
+
     private:
         model::Game& game_;
         app::Players players_;
@@ -710,15 +1232,88 @@ namespace http_handler {
         bool f = true;
 
         extra_data::Json_data lost_objects_json_data_;
+        MapResponses map_responses_;
         bool IsAutomaticTick = false;
 
         std::filesystem::path path_;
+        StaticFilesHolder static_files_;
+        std::string static_cache_control_ = "no-cache";
 
         Strand& strand_;
         app_serialization::SerializingListener serializating_listener_;
         postgres_tools::PostgresDatabase& database_;
+        app::ActionRecorder recorder_;
 
         app::GameTimer game_timer_;
+        StateWaiters state_waiters_;
+
+        //websocket of a player; used on the strand
+        struct GameSocket {
+            std::shared_ptr<http_server::WebSocketSession> ws;
+            app::Token128 token;
+            std::shared_ptr<model::GameSession> session;
+            bool full = false;                                    //full snapshots instead of deltas
+            uint64_t tick = 0;                                    //tick of the last frame sent
+            std::chrono::steady_clock::time_point sent_at = std::chrono::steady_clock::now();
+        };
+
+        static constexpr std::chrono::seconds MAX_SOCKET_LAG{ 5 };
+
+        //cells of a session made for the snapshot "snapshot"; used on the strand
+        struct StateCellsCache {
+            http_server::SharedBody::value_type snapshot;
+            std::unique_ptr<json_writer::StateCells> cells;
+        };
+
+        std::unordered_map<const model::GameSession*, StateCellsCache> state_cells_;
+
+        compression::SharedBodyCache compressed_bodies_;
+
+        //set by the first binary state request; from then on binary snapshots are published every tick
+        std::atomic_bool binary_state_used_ = false;
+
+        std::unordered_map<uint64_t, GameSocket> game_sockets_;
+        //game sockets and spectators closed before they were added: "on_close" may reach the strand ahead of the
+        //socket itself. Sockets are erased only by their "on_close", so every id here is still to be added
+        std::unordered_set<uint64_t> closed_sockets_;
+
+        //spectator of a session; used on the strand
+        struct Spectator {
+            std::shared_ptr<http_server::WebSocketSession> ws;
+            std::chrono::steady_clock::time_point idle_at = std::chrono::steady_clock::now();  //last time no frame was being written
+        };
+
+        struct SpectatorGroup {
+            std::shared_ptr<model::GameSession> session;           //nullptr until the map has a session
+            std::unordered_map<uint64_t, Spectator> sockets;
+        };
+
+        //map id -> spectators of its session
+        std::unordered_map<std::string, SpectatorGroup> spectators_;
+
+        static constexpr unsigned MAX_SPECTATORS_PER_ADDRESS = 16;
+
+        std::mutex spectator_slots_mutex_;
+        std::unordered_map<uint64_t, unsigned> spectator_slots_;      //by RateLimiter::Key of the address, i.e. an IPv6 client by its /64
+        std::atomic<uint64_t> next_socket_id_ = 0;
+
+        app::MpscQueue<MoveCommand> move_commands_;
+        std::atomic_bool moves_posted_ = false;        //a drain of move_commands_ is on its way to the strand
+
+        //limits of a route; set before the server starts and only read afterwards
+        struct RouteRateLimits {
+            RateLimit per_token;
+            RateLimit per_address;
+        };
+
+        static constexpr std::pair<std::string_view, Route> RATE_LIMITED_ROUTES[] = {
+            { "join", Route::AuthGame }, { "players", Route::PlayersList }, { "state", Route::GameState },
+            { "action", Route::MovePlayer }, { "batch", Route::Batch }, { "tick", Route::TimeTick }, { "records", Route::GetRecords },
+            { "socket", Route::GameSocket }, { "spectate", Route::Spectate }
+        };
+
+        std::array<RouteRateLimits, static_cast<size_t>(Route::StaticFile) + 1> rate_limits_{};
+        RateLimiter rate_limiter_;
         
 
 
@@ -730,7 +1325,7 @@ namespace http_handler {
          template <typename Body, typename Allocator>
          void LogRequest(const http::request<Body, http::basic_fields<Allocator>>& req) {
              json::value jv = {
-                 {"URI", static_cast<std::string>(req.target())},
+                 {"URI", RedactQueryParam({ req.target().data(), req.target().size() }, "token")},
                  {"method", req.method_string()}
              };
              BOOST_LOG_TRIVIAL(info) << logging::add_value(additional_data, jv) << "request received";
@@ -754,8 +1349,8 @@ namespace http_handler {
          LoggingRequestHandler& operator=(const LoggingRequestHandler&) = delete;
 
          template <typename Body, typename Allocator, typename Send>
-         void operator()(http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send) {
-             if (static_cast<std::string>(req.target()) != "/favicon.ico"){
+         void operator()(http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send, const boost::asio::ip::address& remote = {}) {
+             if (req.target() != "/favicon.ico"){
                  LogRequest(req);
                  auto t1 = clock();
 
@@ -764,11 +1359,24 @@ namespace http_handler {
                      send(response);
                      auto t2 = clock();
                      this->LogResponse(response, content_type, int(t2 - t1));
-                 });
+                 }, remote);
 
              }
          }
 
+         template <typename Body, typename Allocator, typename Send, typename Accept>
+         void Upgrade(http::request<Body, http::basic_fields<Allocator>>&& req, Send&& send, Accept&& accept, const boost::asio::ip::address& remote = {}) {
+             LogRequest(req);
+             auto t1 = clock();
+             auto logged_send = [send = std::forward<Send>(send), this, t1](auto&& response) {
+                 std::string content_type = response.base()["Content-Type"].to_string();
+                 send(response);
+                 auto t2 = clock();
+                 this->LogResponse(response, content_type, int(t2 - t1));
+                 };
+             request_handler_.Upgrade(std::move(req), logged_send, accept, remote);
+         }
+
      private:
 
          RequestHandlerType& request_handler_;
@@ -0,0 +1,45 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/optional.hpp>
+
+namespace http_server {
+
+    //body of immutable bytes shared between responses: an answer serialized once is sent by any number of
+    //connections without copying it
+    struct SharedBody {
+        using value_type = std::shared_ptr<const std::string>;
+
+        static std::uint64_t size(const value_type& body) {
+            return body ? body->size() : 0;
+        }
+
+        class writer {
+        public:
+            using const_buffers_type = boost::asio::const_buffer;
+
+            template <bool isRequest, typename Fields>
+            writer(const boost::beast::http::header<isRequest, Fields>&, const value_type& body) : body_(body) {
+            }
+
+            void init(boost::beast::error_code& ec) {
+                ec = {};
+            }
+
+            boost::optional<std::pair<const_buffers_type, bool>> get(boost::beast::error_code& ec) {
+                ec = {};
+                if (!body_ || body_->empty())
+                    return boost::none;
+                return { { boost::asio::buffer(*body_), false } };
+            }
+
+        private:
+            const value_type& body_;
+        };
+    };
+
+}  // namespace http_server
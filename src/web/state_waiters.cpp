@@ -0,0 +1,50 @@
+#include "state_waiters.h"
+
+namespace http_handler {
+
+    void StateWaiters::Park(std::shared_ptr<model::GameSession> session, uint64_t tick, Answer answer) {
+        waiters_.push_back({ std::move(session), tick, Clock::now() + TIMEOUT, std::move(answer) });
+        if (!timer_armed_)
+            ScheduleExpiry();
+    }
+
+    void StateWaiters::Release() {
+        if (waiters_.empty())
+            return;
+        auto kept = waiters_.begin();
+        for (auto it = waiters_.begin(); it != waiters_.end(); ++it) {
+            if (it->session->GetHistory().GetTick() > it->tick)
+                ready_.push_back(std::move(*it));
+            else
+                *kept++ = std::move(*it);
+        }
+        waiters_.erase(kept, waiters_.end());
+        for (auto& waiter : ready_)
+            waiter.answer();
+        ready_.clear();
+    }
+
+    void StateWaiters::ScheduleExpiry() {
+        timer_armed_ = true;
+        timer_.expires_at(waiters_.front().deadline);
+        timer_.async_wait([this](boost::system::error_code ec) {
+            OnExpiry(ec);
+            });
+    }
+
+    void StateWaiters::OnExpiry(boost::system::error_code ec) {
+        timer_armed_ = false;
+        if (ec)
+            return;
+        //a waiter that is out of time gets the state as it is
+        auto now = Clock::now();
+        while (!waiters_.empty() && waiters_.front().deadline <= now) {
+            auto answer = std::move(waiters_.front().answer);
+            waiters_.pop_front();
+            answer();
+        }
+        if (!waiters_.empty())
+            ScheduleExpiry();
+    }
+
+}  // namespace http_handler
@@ -0,0 +1,56 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+
+#include "../model/model.h"
+
+namespace http_handler {
+
+    //long-poll requests of /api/v1/game/state?wait=<tick>. A parked request is only its answer: it holds
+    //no thread and no strand time until its session records a tick after "tick" or its deadline passes.
+    //Used on the game strand only
+    class StateWaiters {
+    public:
+        using Strand = boost::asio::strand<boost::asio::io_context::executor_type>;
+        using Answer = std::function<void()>;
+
+        //the connection's write deadline starts when the answer is written (SessionBase::WRITE_TIMEOUT), so
+        //parking does not use it up
+        static constexpr std::chrono::seconds TIMEOUT{ 20 };
+
+        explicit StateWaiters(Strand& strand) : timer_(strand) {
+        }
+
+        void Park(std::shared_ptr<model::GameSession> session, uint64_t tick, Answer answer);
+
+        //answers the waiters whose session has gone past their tick; called after the snapshots are published
+        void Release();
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Waiter {
+            std::shared_ptr<model::GameSession> session;
+            uint64_t tick;
+            Clock::time_point deadline;
+            Answer answer;
+        };
+
+        void ScheduleExpiry();
+        void OnExpiry(boost::system::error_code ec);
+
+        //every waiter gets the same timeout, so the queue is in order of deadlines
+        std::deque<Waiter> waiters_;
+        std::deque<Waiter> ready_;
+        boost::asio::steady_timer timer_;
+        bool timer_armed_ = false;
+    };
+
+}  // namespace http_handler
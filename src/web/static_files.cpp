@@ -0,0 +1,144 @@
+#include "static_files.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#include "compression.h"
+#include "file_types.h"
+
+namespace http_handler {
+
+    namespace {
+        std::string MakeEtag(std::string_view content) {
+            char etag[48];
+            int size = std::snprintf(etag, sizeof(etag), "\"%016zx-%zx\"", std::hash<std::string_view>{}(content), content.size());
+            return { etag, static_cast<size_t>(size) };
+        }
+
+        std::string MakeEtag(const fs::path& file_path, uint64_t size) {
+            auto modified = fs::last_write_time(file_path).time_since_epoch().count();
+            char etag[48];
+            int length = std::snprintf(etag, sizeof(etag), "\"%llx-%llx\"", static_cast<unsigned long long>(modified), static_cast<unsigned long long>(size));
+            return { etag, static_cast<size_t>(length) };
+        }
+
+        std::optional<uint64_t> ParseNumber(std::string_view str) {
+            uint64_t value = 0;
+            auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+            if (str.empty() || ec != std::errc{} || end != str.data() + str.size())
+                return std::nullopt;
+            return value;
+        }
+
+        std::string ReadAll(const fs::path& file_path) {
+            std::ifstream file(file_path, std::ios::binary);
+            if (!file)
+                throw std::runtime_error("Failed to read static file " + file_path.string());
+            return { std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+        }
+    }
+
+    StaticAsset MakeAsset(std::string content, std::string content_type) {
+        StaticAsset asset;
+        asset.content_type = std::move(content_type);
+        asset.etag = MakeEtag(content);
+        asset.size = content.size();
+        if (content.size() >= compression::MIN_SIZE && compression::IsCompressible(asset.content_type)) {
+            auto gzip = compression::Compress(content, compression::Encoding::Gzip, 9);
+            if (gzip.size() < content.size()) {
+                asset.gzip = std::make_shared<const std::string>(std::move(gzip));
+                asset.gzip_etag = CodingEtag(asset.etag, "gzip");
+            }
+        }
+        asset.body = std::make_shared<const std::string>(std::move(content));
+        return asset;
+    }
+
+    std::shared_ptr<const StaticFiles> StaticFiles::Build(const fs::path& root) {
+        auto files = std::make_shared<StaticFiles>();
+        auto base = fs::weakly_canonical(root);
+        for (auto& entry : fs::recursive_directory_iterator(base)) {
+            if (!entry.is_regular_file() || !IsAccessibleFile(entry.path(), base))
+                continue;
+            auto content_type = GetFileType(entry.path().filename().string());
+            auto size = entry.file_size();
+            StaticAsset asset;
+            if (size < LARGE_FILE_SIZE) {
+                asset = MakeAsset(ReadAll(entry.path()), std::move(content_type));
+            }
+            else {
+                //a large file stays on disk and is not hashed; only its gzip copy (if any) is kept
+                asset.content_type = std::move(content_type);
+                asset.size = size;
+                asset.etag = MakeEtag(entry.path(), size);
+                if (compression::IsCompressible(asset.content_type)) {
+                    auto content = ReadAll(entry.path());
+                    auto gzip = compression::Compress(content, compression::Encoding::Gzip, 9);
+                    if (gzip.size() < content.size()) {
+                        asset.gzip = std::make_shared<const std::string>(std::move(gzip));
+                        asset.gzip_etag = CodingEtag(asset.etag, "gzip");
+                    }
+                }
+            }
+            asset.file = entry.path();
+            files->assets_.emplace("/" + entry.path().lexically_relative(base).generic_string(), std::move(asset));
+        }
+        return files;
+    }
+
+    std::string CodingEtag(std::string_view etag, std::string_view coding) {
+        std::string result(etag);
+        auto position = result.ends_with('"') ? result.size() - 1 : result.size();
+        result.insert(position, "-" + std::string(coding));
+        return result;
+    }
+
+    std::optional<ByteRange> ParseRange(std::string_view range, uint64_t size) {
+        if (!range.starts_with("bytes="))
+            return std::nullopt;
+        range.remove_prefix(6);
+        auto dash = range.find('-');
+        if (dash == std::string_view::npos || range.find(',') != std::string_view::npos)
+            return std::nullopt;
+        auto first = range.substr(0, dash);
+        auto last = range.substr(dash + 1);
+        if (first.empty()) {
+            //"-N" - the last N bytes
+            auto suffix = ParseNumber(last);
+            if (!suffix)
+                return std::nullopt;
+            auto length = std::min(*suffix, size);
+            return ByteRange{ size - length, length };
+        }
+        auto from = ParseNumber(first);
+        if (!from)
+            return std::nullopt;
+        auto to = last.empty() ? std::optional<uint64_t>(UINT64_MAX) : ParseNumber(last);
+        if (!to || *to < *from)
+            return std::nullopt;
+        if (*from >= size)
+            return ByteRange{ *from, 0 };
+        return ByteRange{ *from, std::min(*to, size - 1) - *from + 1 };
+    }
+
+    bool EtagMatches(std::string_view if_none_match, std::string_view etag) {
+        while (!if_none_match.empty()) {
+            auto comma = if_none_match.find(',');
+            auto tag = if_none_match.substr(0, comma);
+            if_none_match = comma == std::string_view::npos ? std::string_view{} : if_none_match.substr(comma + 1);
+            while (!tag.empty() && tag.front() == ' ')
+                tag.remove_prefix(1);
+            while (!tag.empty() && tag.back() == ' ')
+                tag.remove_suffix(1);
+            if (tag.starts_with("W/"))
+                tag.remove_prefix(2);
+            if (tag == "*" || tag == etag)
+                return true;
+        }
+        return false;
+    }
+
+}  // namespace http_handler
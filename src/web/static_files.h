@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace http_handler {
+
+    namespace fs = std::filesystem;
+
+    //files from this size on stay on disk and are sent with sendfile (see http_server::FileRangeBody)
+    constexpr uint64_t LARGE_FILE_SIZE = 256 * 1024;
+
+    //a file of the www-root tree; read into memory unless it is large
+    struct StaticAsset {
+        std::string content_type;
+        std::string etag;                            //strong, with the quotes
+        std::string gzip_etag;                       //of the gzip copy; a content-coding has a validator of its own
+        fs::path file;
+        uint64_t size = 0;
+        std::shared_ptr<const std::string> body;     //nullptr for a large file
+        std::shared_ptr<const std::string> gzip;     //nullptr if compression does not pay off
+    };
+
+    //single byte range of a "Range" request
+    struct ByteRange {
+        uint64_t first = 0;
+        uint64_t length = 0;                         //0 if the range is not satisfiable
+    };
+
+    //immutable index of the www-root tree keyed by the decoded request path ("/index.html"), built once and
+    //then read by any number of threads; serving from it never touches the filesystem
+    class StaticFiles {
+    public:
+        //reads every regular file under "root" that lies inside it
+        static std::shared_ptr<const StaticFiles> Build(const fs::path& root);
+
+        const StaticAsset* Find(std::string_view path) const {
+            auto it = assets_.find(path);
+            return it == assets_.end() ? nullptr : &it->second;
+        }
+
+        size_t Size() const {
+            return assets_.size();
+        }
+
+    private:
+        //lookup by std::string_view without making a string
+        struct PathHash {
+            using is_transparent = void;
+
+            size_t operator()(std::string_view path) const {
+                return std::hash<std::string_view>{}(path);
+            }
+        };
+
+        std::unordered_map<std::string, StaticAsset, PathHash, std::equal_to<>> assets_;
+    };
+
+    //current StaticFiles of the server; Rebuild swaps in a new table while requests keep reading the old one
+    class StaticFilesHolder {
+    public:
+        std::shared_ptr<const StaticFiles> Get() const {
+            return files_.load(std::memory_order_acquire);
+        }
+
+        void Rebuild(const fs::path& root) {
+            files_.store(StaticFiles::Build(root), std::memory_order_release);
+        }
+
+    private:
+        std::atomic<std::shared_ptr<const StaticFiles>> files_ = std::make_shared<const StaticFiles>();
+    };
+
+    //in-memory asset of "content" with its ETag and, if it pays off, a gzip copy
+    StaticAsset MakeAsset(std::string content, std::string content_type);
+
+    //strong ETag of the "coding" form ("gzip", "deflate") of the representation with "etag": "\"abc\"" -> "\"abc-gzip\""
+    std::string CodingEtag(std::string_view etag, std::string_view coding);
+
+    //"Range" header "range" of a file of "size" bytes; std::nullopt if it is not a single "bytes" range
+    //(then the whole file is sent)
+    std::optional<ByteRange> ParseRange(std::string_view range, uint64_t size);
+
+    //true if the "If-None-Match" list "if_none_match" names "etag" (weak comparison, as RFC 9110 asks for it)
+    bool EtagMatches(std::string_view if_none_match, std::string_view etag);
+
+}  // namespace http_handler
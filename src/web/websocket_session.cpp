@@ -0,0 +1,114 @@
+#include "websocket_session.h"
+
+#include <boost/asio/dispatch.hpp>
+
+#include "log.h"
+
+namespace http_server {
+
+    WebSocketSession::WebSocketSession(beast::tcp_stream&& stream, FrameHandler on_frame, CloseHandler on_close)
+        : ws_(std::move(stream)), on_frame_(std::move(on_frame)), on_close_(std::move(on_close)) {
+        busy_ = true;   //until the handshake is done
+    }
+
+    void WebSocketSession::Run(HttpRequest&& upgrade) {
+        upgrade_ = std::move(upgrade);
+        boost::asio::dispatch(ws_.get_executor(), [self = shared_from_this()]() {
+            beast::get_lowest_layer(self->ws_).expires_never();
+            self->ws_.set_option(websocket::stream_base::timeout::suggested(beast::role_type::server));
+            self->ws_.read_message_max(MAX_CLIENT_FRAME);
+            self->ws_.async_accept(self->upgrade_, [self](beast::error_code ec) {
+                self->OnAccept(ec);
+                });
+            });
+    }
+
+    bool WebSocketSession::Send(std::shared_ptr<const std::string> frame) {
+        if (busy_.exchange(true, std::memory_order_acq_rel))
+            return false;
+        boost::asio::dispatch(ws_.get_executor(), [self = shared_from_this(), frame = std::move(frame)]() mutable {
+            self->Write(std::move(frame));
+            });
+        return true;
+    }
+
+    void WebSocketSession::Push(std::shared_ptr<const std::string> frame) {
+        boost::asio::dispatch(ws_.get_executor(), [self = shared_from_this(), frame = std::move(frame)]() mutable {
+            if (self->busy_.exchange(true, std::memory_order_acq_rel))
+                self->pending_ = std::move(frame);
+            else
+                self->Write(std::move(frame));
+            });
+    }
+
+    void WebSocketSession::Write(std::shared_ptr<const std::string> frame) {
+        if (closed_) {
+            pending_.reset();
+            busy_.store(false, std::memory_order_release);
+            return;
+        }
+        ws_.text(true);
+        ws_.async_write(boost::asio::buffer(*frame), [self = shared_from_this(), frame](beast::error_code ec, std::size_t) {
+            self->OnWrite(ec);
+            });
+    }
+
+    void WebSocketSession::Drop() {
+        boost::asio::dispatch(ws_.get_executor(), [self = shared_from_this()]() {
+            beast::error_code ec;
+            beast::get_lowest_layer(self->ws_).socket().close(ec);
+            self->Closed();
+            });
+    }
+
+    void WebSocketSession::OnAccept(beast::error_code ec) {
+        if (ec) {
+            ServerErrorLog(ec.value(), ec.message(), "websocket accept");
+            return Closed();
+        }
+        upgrade_ = {};
+        Read();
+        if (pending_)
+            Write(std::move(pending_));
+        else
+            busy_ = false;
+    }
+
+    void WebSocketSession::Read() {
+        ws_.async_read(buffer_, [self = shared_from_this()](beast::error_code ec, std::size_t bytes_read) {
+            self->OnRead(ec, bytes_read);
+            });
+    }
+
+    void WebSocketSession::OnRead(beast::error_code ec, std::size_t bytes_read) {
+        if (ec) {
+            if (ec != websocket::error::closed && ec != boost::asio::error::operation_aborted)
+                ServerErrorLog(ec.value(), ec.message(), "websocket read");
+            return Closed();
+        }
+        auto data = buffer_.cdata();
+        on_frame_({ static_cast<const char*>(data.data()), data.size() });
+        buffer_.consume(bytes_read);
+        Read();
+    }
+
+    void WebSocketSession::OnWrite(beast::error_code ec) {
+        if (ec) {
+            if (ec != boost::asio::error::operation_aborted)
+                ServerErrorLog(ec.value(), ec.message(), "websocket write");
+            return Closed();
+        }
+        if (pending_)
+            Write(std::move(pending_));
+        else
+            busy_.store(false, std::memory_order_release);
+    }
+
+    void WebSocketSession::Closed() {
+        if (closed_)
+            return;
+        closed_ = true;
+        on_close_();
+    }
+
+}  // namespace http_server
@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+
+#include "arena.h"
+
+namespace http_server {
+
+    namespace beast = boost::beast;
+    namespace http = beast::http;
+    namespace websocket = beast::websocket;
+
+    //request fields and body live in the arena of the connection
+    using HttpRequest = http::request<http::basic_string_body<char, std::char_traits<char>, ArenaAllocator<char>>, http::basic_fields<ArenaAllocator<char>>>;
+
+    //connection taken over from an http session after a websocket upgrade. Frames of the client are
+    //handed to "on_frame", server frames are written one at a time and at most one more waits behind them,
+    //so a slow client gets fewer frames instead of a growing queue. A frame is written from the shared
+    //string itself: one encoded frame is sent to any number of sessions without copies
+    class WebSocketSession : public std::enable_shared_from_this<WebSocketSession> {
+    public:
+        //called on the executor of the connection
+        using FrameHandler = std::function<void(std::string_view frame)>;
+        using CloseHandler = std::function<void()>;
+
+        //longest frame accepted from a client
+        static constexpr size_t MAX_CLIENT_FRAME = 1024;
+
+        WebSocketSession(beast::tcp_stream&& stream, FrameHandler on_frame, CloseHandler on_close);
+
+        //answers "upgrade" and starts reading frames
+        void Run(HttpRequest&& upgrade);
+
+        //true while a frame is being written
+        bool IsBusy() const {
+            return busy_.load(std::memory_order_acquire);
+        }
+
+        //may be called from any thread; false if the previous frame is still being written (then "frame" is dropped)
+        bool Send(std::shared_ptr<const std::string> frame);
+
+        //may be called from any thread; "frame" waits while the previous one is being written and is replaced
+        //by the next Push, i.e. a slow client skips intermediate frames. For frames that each stand alone
+        void Push(std::shared_ptr<const std::string> frame);
+
+        //drops the connection without the closing handshake: a client that does not read would never finish it
+        void Drop();
+
+    private:
+        void OnAccept(beast::error_code ec);
+        void Read();
+        void OnRead(beast::error_code ec, std::size_t bytes_read);
+        void Write(std::shared_ptr<const std::string> frame);
+        void OnWrite(beast::error_code ec);
+        void Closed();
+
+        websocket::stream<beast::tcp_stream> ws_;
+        beast::flat_buffer buffer_;
+        HttpRequest upgrade_;
+        std::shared_ptr<const std::string> pending_;
+        FrameHandler on_frame_;
+        CloseHandler on_close_;
+        std::atomic_bool busy_ = false;
+        bool closed_ = false;
+    };
+
+}  // namespace http_server